@@ -63,6 +63,8 @@
 
 // Encoder Offset if reading does not start at 0 at the start of the encoder
 #define ENCODER_OFFSET       124.9 // in inches
+static_assert(INCHES_FIT_POSITION(ENCODER_OFFSET), 
+              "ENCODER_OFFSET does not fit in the POSITION_UNITS in use");
 
 // Linear Potentiometer calibration values
 #define LIN_POT_OFFSET       -1.43+.640
@@ -76,6 +78,40 @@
 //		11 			->	3 	(Master Out Slave In) 
 // 		12 			->	4 	(Master In Slave Out)
 // 		13 			-> 	2 	(Serial Clock)
+//		2 			<-	nINT 	(end of transmission interrupt)
+#define MB4_INTERRUPT 	2
+
+// How often the display and serial output are refreshed in encoder mode. 
+// The encoder itself is sampled on every cycle of the MB4.
+#define DISPLAY_PERIOD    100 // in milliseconds
+
+// How quickly the piston velocity follows the encoder samples
+#define VELOCITY_BANDWIDTH   20 // in Hz
+
+// The encoder is read every FAST_CYCLE_PERIOD while the piston moves faster
+// than FAST_VELOCITY, and every SLOW_CYCLE_PERIOD once it has settled. Every
+// cycle costs the end of transmission interrupt one frame read: about 60 us
+// with fast access at 8 MHz, and up to about 180 us if the SPI clock can't be
+// raised past 1 MHz. That is 12 to 36 % of the CPU at 500 us. loop() needs 
+// the rest for readSample(), the observer, the decimator and the adaptive
+// rate on every sample, so the fast period should not be shortened without
+// raising the SPI clock further.
+#define FAST_CYCLE_PERIOD    500  // in microseconds
+#define SLOW_CYCLE_PERIOD    2000 // in microseconds
+#define FAST_VELOCITY        0.5  // in inches per second
+static_assert(INCHES_FIT_POSITION(FAST_VELOCITY), 
+              "FAST_VELOCITY does not fit in the POSITION_UNITS in use");
+
+// How many encoder samples are averaged into each displayed position, and
+// the number of stages of the averaging filter
+#define DISPLAY_DECIMATION   32
+#define DISPLAY_FILTER_ORDER 2
+
+// Uncomment to time the software CRC check against the STATUS_REG and SVALID
+// read it replaces, once the MB4 has started up. BENCHMARK_BLOCKS blocks of 
+// MAX_SLAVES frames are checked, and the registers are read as many times.
+// #define BENCHMARK_CRC
+#define BENCHMARK_BLOCKS     200
 
 // Linear Pot
 #define LIN_POT   A0
@@ -101,9 +137,26 @@ float linearPotToInches(uint16_t rawPosition, float offset);
 // Function for setting the measurement mode to encoder or linear pot
 uint8_t setMeasureMode();
 
+#ifdef BENCHMARK_CRC
+// Function for timing the software CRC check on the board
+void benchmarkCRC(MB4Driver& master);
+#endif
+
 // create a 7 segment display object for displaying the reading
 Adafruit_7segment display = Adafruit_7segment();
 
+// Buffer of encoder samples captured by the MB4 interrupt, waiting to be 
+// used in loop()
+SampleBuffer encoderSamples;
+
+// Observer tracking the piston velocity from every encoder sample, so that it
+// stays accurate however slowly the display is refreshed
+PositionObserver pistonObserver(VELOCITY_BANDWIDTH);
+
+// Decimator averaging the encoder samples down into finer positions for the 
+// display and serial output
+PositionDecimator displayDecimator(DISPLAY_DECIMATION, DISPLAY_FILTER_ORDER);
+
 // This setup function is required by arduino and runs once upon startup 
 // of the microcontroller or after a reset.
 void setup() {
@@ -137,17 +190,99 @@ void loop() {
      // create an MB4 master object that is connected to the encoder
      MB4Driver master = MB4Driver(SELECT, ENCODER_OFFSET);
 
+     // Start up the MB4 one step at a time, so that the mode switch is 
+     // still watched while waiting for the encoder
+     master.begin();
+     while (!master.poll()) {
+      if (master.hasFailed()) {
+        Serial.println("MB4 start up failed, retrying");
+        master.begin();
+      }
+      // Check for a mode change
+      if (!(digitalRead(SWITCH))){
+        mode = setMeasureMode();
+        return;
+      }
+     }
+
+     // Keep the frame read of every cycle short, see FAST_CYCLE_PERIOD
+     master.calibrateSPIClock();
+     master.setFastAccess(true);
+
+#ifdef BENCHMARK_CRC
+     benchmarkCRC(master);
+#endif
+
      // Raw position in bits
      static uint32_t rawPosition;
 
-     // Inner while loop for simply updating the encoder readings and output
-     // the readings to the disply
+     // Capture a sample on every cycle of the MB4 from now on
+     encoderSamples.clear();
+     pistonObserver.reset();
+     master.setObserver(&pistonObserver);
+     displayDecimator.reset();
+     master.setDecimator(&displayDecimator);
+     master.setAdaptiveRate(FAST_CYCLE_PERIOD, SLOW_CYCLE_PERIOD, 
+                            INCHES_TO_POSITION(FAST_VELOCITY));
+     master.beginInterruptAcquisition(MB4_INTERRUPT, &encoderSamples);
+
+     // Ask the encoder for its serial number, which arrives over the next few
+     // cycles without holding up the position readings
+     master.requestEncoderRead(BISS_SERIAL_NUMBER, BISS_SERIAL_NUMBER_SIZE);
+
+     // The last time the display was refreshed
+     unsigned long lastDisplay = millis();
+
+     // Inner while loop for collecting the encoder samples as they arrive 
+     // and periodically outputting the readings to the display
      while (true) {
-      // Get the raw encoder position
-      rawPosition = master.getRawPosition();
+      // Collect every sample captured since the last pass, keeping the 
+      // position from the latest valid one. A status of 0 has no encoder 
+      // error or warning bits and no CRC error.
+      Sample sample;
+      while (master.readSample(sample)) {
+        if (sample.status == 0) {
+          rawPosition = sample.rawPosition;
+        }
+      }
+
+      // Check for a mode change
+      if (!(digitalRead(SWITCH))){
+        // Stop capturing before the driver goes out of scope
+        master.endInterruptAcquisition();
+        // Set the measurement mode to the new state
+        mode = setMeasureMode();
+        // Break out of this inner while loop so that the other state can be reached
+        break;
+      }
+
+      // Print out the encoder serial number once it has been read
+      if (master.pollEncoderTransfer() == MB4Driver::transfer_done) {
+        uint8_t serialNumber[BISS_SERIAL_NUMBER_SIZE];
+        master.readEncoderData(serialNumber, BISS_SERIAL_NUMBER_SIZE);
+        Serial.print("Encoder Serial Number = \t");
+        for (uint8_t i = 0; i < BISS_SERIAL_NUMBER_SIZE; i++) {
+          Serial.print(serialNumber[i], HEX);
+        }
+        Serial.println();
+      }
 
-      // Get the position in inches
-      position = abs(master.getPosition());
+      // Only refresh the display and serial output once per display period
+      if (millis() - lastDisplay < DISPLAY_PERIOD) {
+        continue;
+      }
+      lastDisplay = millis();
+
+      // Get the position in inches, from the averaged samples once there
+      // are enough of them
+      DecimatedSample averaged;
+      if (displayDecimator.read(averaged)) {
+        position = abs((float)master.convertDecimatedFixed(averaged) 
+                       / POSITION_UNITS_PER_INCH);
+      }
+      else {
+        position = abs(master.getLastPosition());
+      }
 
       // Display the position
       display.println(position, 3); // Try to diplay to 3rd decimal point
@@ -159,16 +294,27 @@ void loop() {
 
       // Print out the raw bit position as well for debugging 
       Serial.print("\t Raw Position [bits] = \t");
-      Serial.println(rawPosition);
-      // Check for a mode change
-      if (!(digitalRead(SWITCH))){
-        // Set the measurement mode to the new state
-        mode = setMeasureMode();
-        // Break out of this inner while loop so that the other state can be reached
-        break;
+      Serial.print(rawPosition);
+
+      // Print out the piston velocity, once the observer has settled
+      if (pistonObserver.isTracking()) {
+        ObserverState piston = pistonObserver.getState();
+        Serial.print("\t Velocity [in/s] = \t");
+        Serial.print((float)master.convertCountsFixed(piston.velocity) 
+                     / POSITION_UNITS_PER_INCH, 3);
       }
-      // Delay after breaking out of the while loop for 100ms
-      delay(100);
+
+      // Print out how often the encoder is being read
+      Serial.print("\t Cycle [us] = \t");
+      Serial.print(master.getCyclePeriod());
+
+      // Print out how many samples were dropped because loop() fell behind
+      Serial.print("\t Overruns = \t");
+      Serial.print(encoderSamples.getOverruns());
+
+      // Print out the status of the encoder (0 is no errors)
+      Serial.print("\t Status = \t");
+      Serial.println(master.getHealth().state);
     }
    }
    else if (mode == linearPot) {
@@ -272,3 +418,43 @@ uint8_t setMeasureMode(){
   // Return the mode based upon the position of the switch
   return mode;
 }
+
+#ifdef BENCHMARK_CRC
+// Function for timing the software CRC check of a block of frames against 
+// reading STATUS_REG and SVALID, which is what the MB4's own check costs 
+// every sample, and printing both over Serial
+// Parameters:
+// master: the driver of an MB4 that has started up
+// returns: nothing
+
+void benchmarkCRC(MB4Driver& master) {
+  // Check copies of a real frame, as many as the MB4 could have slaves
+  MB4Driver::PositionFrame frames[MAX_SLAVES];
+  MB4Driver::PositionFrame frame = master.readPositionFrame();
+  for (uint8_t i = 0; i < MAX_SLAVES; i++) {
+    frames[i] = frame;
+  }
+
+  uint16_t errors = 0;
+  unsigned long start = micros();
+  for (uint16_t block = 0; block < BENCHMARK_BLOCKS; block++) {
+    errors += master.checkFrameCRCs(frames, MAX_SLAVES);
+  }
+  unsigned long softwareTime = micros() - start;
+
+  uint8_t registers[2];
+  start = micros();
+  for (uint16_t block = 0; block < BENCHMARK_BLOCKS; block++) {
+    master.readRegister(STATUS_REG, registers, sizeof(registers));
+  }
+  unsigned long hardwareTime = micros() - start;
+
+  // micros() counts in steps of 4 us, which the many frames average out
+  Serial.print("Software CRC [cycles/frame] = \t");
+  Serial.print((float)softwareTime * (F_CPU / 1000000L) / ((float)BENCHMARK_BLOCKS * MAX_SLAVES), 1);
+  Serial.print("\t SVALID read [us/sample] = \t");
+  Serial.print((float)hardwareTime / BENCHMARK_BLOCKS, 1);
+  Serial.print("\t CRC errors = \t");
+  Serial.println(errors);
+}
+#endif
@@ -0,0 +1,274 @@
+/* calibration-table.cpp
+   Piecewise linear calibration of measured positions, kept in PROGMEM or EEPROM.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <EEPROM.h>
+
+#include "calibration-table.h"
+
+// CalibrationTable constructor: an empty table, which corrects nothing
+CalibrationTable::CalibrationTable(){
+   this->clear();
+}
+
+// clear: empties the table so that it corrects nothing
+// Parameters: None
+// returns: nothing
+void CalibrationTable::clear(){
+   this->numSegments = 0;
+   this->lastSegment = 0;
+}
+
+// loadProgmem: loads a table kept in PROGMEM
+// Parameters: 
+// table: the segments in PROGMEM, sorted by their start
+// count: the number of segments
+// returns: false if there are more segments than the table can hold
+bool CalibrationTable::loadProgmem(const CalibrationSegment* table, uint8_t count){
+   if (count > CALIBRATION_MAX_SEGMENTS) {
+      return false;
+   }
+
+   memcpy_P(this->segments, table, count * sizeof(CalibrationSegment));
+   this->numSegments = count;
+   this->lastSegment = 0;
+   return true;
+}
+
+// checksum: works out the checksum of the segments in use
+// Parameters: None
+// returns: the sum of their bytes
+uint8_t CalibrationTable::checksum(){
+   uint8_t sum = this->numSegments;
+   uint8_t* bytes = (uint8_t*)this->segments;
+   for(uint16_t index = 0; index < this->numSegments * sizeof(CalibrationSegment); index++){
+      sum += bytes[index];
+   }
+   return sum;
+}
+
+// load: loads a table saved in EEPROM by save(). The table is left as it was
+//       if nothing valid was saved there.
+// Parameters: 
+// address: (optional parameter) the EEPROM address the table was saved at
+// returns: true if a table was loaded
+bool CalibrationTable::load(int address){
+   uint16_t magic = EEPROM.read(address) | (EEPROM.read(address + 1) << 8);
+   uint8_t count = EEPROM.read(address + 2);
+   if (magic != CALIBRATION_MAGIC || count > CALIBRATION_MAX_SEGMENTS) {
+      return false;
+   }
+
+   CalibrationTable loaded;
+   uint8_t* bytes = (uint8_t*)loaded.segments;
+   for(uint16_t index = 0; index < count * sizeof(CalibrationSegment); index++){
+      bytes[index] = EEPROM.read(address + 3 + index);
+   }
+   loaded.numSegments = count;
+
+   if (loaded.checksum() != EEPROM.read(address + 3 + count * sizeof(CalibrationSegment))) {
+      return false;
+   }
+
+   *this = loaded;
+   return true;
+}
+
+// save: saves the table to EEPROM, only writing the bytes that changed
+// Parameters: 
+// address: (optional parameter) the EEPROM address to save the table at
+// returns: nothing
+void CalibrationTable::save(int address){
+   EEPROM.update(address, CALIBRATION_MAGIC & 0xFF);
+   EEPROM.update(address + 1, CALIBRATION_MAGIC >> 8);
+   EEPROM.update(address + 2, this->numSegments);
+
+   uint8_t* bytes = (uint8_t*)this->segments;
+   for(uint16_t index = 0; index < this->numSegments * sizeof(CalibrationSegment); index++){
+      EEPROM.update(address + 3 + index, bytes[index]);
+   }
+   EEPROM.update(address + 3 + this->numSegments * sizeof(CalibrationSegment), 
+                 this->checksum());
+}
+
+// findSegment: finds the segment a measured position falls into. The last 
+//              segment used and the one after it are tried first, since the
+//              encoder rarely moves further between samples.
+// Parameters: 
+// measured: the measured position, at or above the start of the first segment
+// returns: the index of the segment
+uint8_t CalibrationTable::findSegment(int32_t measured){
+   uint8_t segment = this->lastSegment;
+   for(uint8_t tried = 0; tried < 2 && segment < this->numSegments; tried++, segment++){
+      if (this->segments[segment].start <= measured && 
+          (segment + 1 == this->numSegments || measured < this->segments[segment + 1].start)) {
+         return segment;
+      }
+   }
+
+   // Binary search for the last segment starting at or below the position
+   uint8_t low = 0;
+   uint8_t high = this->numSegments - 1;
+   while (low < high) {
+      uint8_t middle = (low + high + 1) / 2;
+      if (this->segments[middle].start <= measured) {
+         low = middle;
+      }
+      else {
+         high = middle - 1;
+      }
+   }
+   return low;
+}
+
+// correct: corrects a measured position
+// Parameters: 
+// measured: the measured position
+// returns: the corrected position
+int32_t CalibrationTable::correct(int32_t measured){
+   if (this->numSegments == 0) {
+      return measured;
+   }
+   if (measured < this->segments[0].start) {
+      return measured + this->segments[0].correction;
+   }
+
+   this->lastSegment = this->findSegment(measured);
+   const CalibrationSegment& segment = this->segments[this->lastSegment];
+
+   int32_t corrected = measured + segment.correction;
+   if (segment.slope != 0) {
+      corrected += (int32_t)(((int64_t)(measured - segment.start) * segment.slope) >> 16);
+   }
+   return corrected;
+}
+
+// beginCapture: empties the table, ready for references to be added
+// Parameters: None
+// returns: nothing
+void CalibrationTable::beginCapture(){
+   this->clear();
+}
+
+// addReference: adds a reference taken during a sweep: the position measured
+//               while the encoder was at a known position. References can be 
+//               added in any order.
+// Parameters: 
+// measured: the position measured, without any calibration
+// reference: the known position
+// returns: false if the table is already full
+bool CalibrationTable::addReference(int32_t measured, int32_t reference){
+   if (this->numSegments == CALIBRATION_MAX_SEGMENTS) {
+      return false;
+   }
+
+   CalibrationSegment& segment = this->segments[this->numSegments++];
+   segment.start = measured;
+   segment.correction = reference - measured;
+   segment.slope = 0;
+   return true;
+}
+
+// endCapture: builds the table from the references added. They are sorted by
+//             the position measured, and the correction is interpolated 
+//             between neighbouring references unless it changes faster than
+//             CALIBRATION_MAX_SLOPE, in which case it steps at the second one.
+//             Above the last reference the correction stays as it was there.
+// Parameters: None
+// returns: true if there was at least one reference
+bool CalibrationTable::endCapture(){
+   // Insertion sort, since there are only a few references
+   for(uint8_t index = 1; index < this->numSegments; index++){
+      CalibrationSegment segment = this->segments[index];
+      uint8_t position = index;
+      while (position > 0 && this->segments[position - 1].start > segment.start) {
+         this->segments[position] = this->segments[position - 1];
+         position--;
+      }
+      this->segments[position] = segment;
+   }
+
+   // Keep only the first of several references at the same position
+   uint8_t kept = 0;
+   for(uint8_t index = 0; index < this->numSegments; index++){
+      if (kept == 0 || this->segments[index].start != this->segments[kept - 1].start) {
+         this->segments[kept++] = this->segments[index];
+      }
+   }
+   this->numSegments = kept;
+
+   for(uint8_t index = 0; index + 1 < this->numSegments; index++){
+      CalibrationSegment& segment = this->segments[index];
+      CalibrationSegment& next = this->segments[index + 1];
+
+      int64_t slope = ((int64_t)(next.correction - segment.correction) << 16) 
+                      / (next.start - segment.start);
+      if (slope > CALIBRATION_MAX_SLOPE || slope < -CALIBRATION_MAX_SLOPE) {
+         slope = 0;
+      }
+      segment.slope = (int32_t)slope;
+   }
+
+   this->lastSegment = 0;
+   return this->numSegments > 0;
+}
+
+// getSegmentCount: gets the number of segments in the table
+// Parameters: None
+// returns: the number of segments
+uint8_t CalibrationTable::getSegmentCount(){
+   return this->numSegments;
+}
+
+// print: prints the segments over Serial, one per line as start, correction
+//        and slope
+// Parameters: None
+// returns: nothing
+void CalibrationTable::print(){
+   Serial.println("------ Calibration Table ------");
+   for(uint8_t index = 0; index < this->numSegments; index++){
+      Serial.print(this->segments[index].start);
+      Serial.print("\t| ");
+      Serial.print(this->segments[index].correction);
+      Serial.print("\t| ");
+      Serial.println(this->segments[index].slope);
+   }
+   Serial.println("------ End of Calibration Table -------");
+}
@@ -0,0 +1,120 @@
+/* calibration-table.h
+   Piecewise linear calibration of measured positions, kept in PROGMEM or EEPROM.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef CALIBRATION_TABLE_H
+#define CALIBRATION_TABLE_H
+
+#include <Arduino.h>
+
+// Most segments a table can hold. Each takes 12 bytes of RAM.
+#ifndef CALIBRATION_MAX_SEGMENTS
+#define CALIBRATION_MAX_SEGMENTS   8
+#endif
+
+// Steepest change in correction between two captured references, per unit 
+// of position in 16.16 fixed point (1/8). Anything steeper is taken to be a 
+// step, such as where the encoder runs off the strip, rather than a slope.
+#define CALIBRATION_MAX_SLOPE      (65536L / 8)
+
+// Where a table is kept in EEPROM, and the marker that shows one was saved
+#define CALIBRATION_EEPROM_ADDRESS   0
+#define CALIBRATION_MAGIC            0xCA1B
+
+// The lowest position, for a segment that covers everything below the next
+#define CALIBRATION_MIN_POSITION     (-2147483647L - 1)
+
+// CalibrationSegment: a run of measured positions sharing one linear 
+//                     correction, up to the start of the next segment
+struct CalibrationSegment
+{
+   int32_t start;        // First measured position of the segment
+   int32_t correction;   // Correction added to the measured position at start
+   int32_t slope;        // Change in correction per unit of position (16.16)
+};
+
+// CalibrationTable class: corrects measured positions with a table of 
+//                         segments sorted by their start. Within a segment the
+//                         correction is interpolated with integer math, and 
+//                         between segments it can step. The segment used last
+//                         is checked first, so following a moving encoder 
+//                         takes constant time, and any other position is found
+//                         with a binary search. Positions below the first 
+//                         segment get its correction at its start.
+//
+// Tables come from PROGMEM, from EEPROM, or from a capture: references taken
+// at known positions during a sweep, one segment per reference.
+class CalibrationTable {
+   private:
+      CalibrationSegment segments[CALIBRATION_MAX_SEGMENTS];
+      uint8_t numSegments;
+
+      // The segment the last corrected position fell into
+      uint8_t lastSegment;
+
+      uint8_t findSegment(int32_t measured);
+
+      uint8_t checksum();
+
+   public:
+      CalibrationTable();
+
+      void clear();
+
+      bool loadProgmem(const CalibrationSegment* table, uint8_t count);
+
+      bool load(int address = CALIBRATION_EEPROM_ADDRESS);
+
+      void save(int address = CALIBRATION_EEPROM_ADDRESS);
+
+      int32_t correct(int32_t measured);
+
+      void beginCapture();
+
+      bool addReference(int32_t measured, int32_t reference);
+
+      bool endCapture();
+
+      uint8_t getSegmentCount();
+
+      void print();
+};
+
+#endif
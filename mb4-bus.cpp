@@ -0,0 +1,350 @@
+/* mb4-bus.cpp
+   Source code for a class for sharing one SPI bus between several IC-MB4 master ICs.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Include the header file which has all of the prototypes of the functions
+// contained in this source file.
+#include "mb4-bus.h"
+
+// MB4Bus: Constructor for the MB4Bus class, starts out with no devices
+// Parameters: none
+MB4Bus::MB4Bus(){
+   this->numDevices = 0;
+   this->totalWeight = 0;
+   this->resetStatistics();
+}
+
+// addDevice: adds a driver to the bus. Each driver must have its own chip 
+//            select pin and must already have been started, with begin() and
+//            then poll() until it returned true.
+// Parameters:
+// driver: the driver to add
+// weight: (optional parameter) how many times the driver is read each round,
+//         relative to the other drivers
+// returns: true if the driver was added, false if the bus is full or the 
+//          driver has not finished starting up
+bool MB4Bus::addDevice(MB4Driver* driver, uint8_t weight){
+   if (this->numDevices >= MAX_BUS_DEVICES || weight == 0 || !driver->isReady()) {
+      return false;
+   }
+
+   Device& device = this->devices[this->numDevices];
+   device.driver = driver;
+   device.weight = weight;
+   device.credit = 0;
+   device.samples = 0;
+   device.skipped = 0;
+   device.busyMicros = 0;
+
+   this->numDevices++;
+   this->totalWeight += weight;
+
+   this->updateSPISettings();
+
+   return true;
+}
+
+// updateSPISettings: works out the SPI settings for a round of reads. Since 
+//                    every driver is read inside the same transaction, this 
+//                    uses the clock of the slowest driver. This must be 
+//                    called again if the clock of a driver is changed after
+//                    it was added.
+// Parameters: none
+// returns: nothing
+void MB4Bus::updateSPISettings(){
+   uint32_t clock = MAX_SPI_CLOCK;
+   for(uint8_t index = 0; index < this->numDevices; index++){
+      if (this->devices[index].driver->getSPIClock() < clock) {
+         clock = this->devices[index].driver->getSPIClock();
+      }
+   }
+   this->spiSettings = SPISettings(clock, MSBFIRST, SPI_MODE0);
+}
+
+// nextDevice: picks the next device to read. Every device earns its weight in
+//             credit, the device with the most credit is picked and pays 
+//             for the pick with the total weight. Over a round every device
+//             is picked exactly as many times as its weight.
+// Parameters: none
+// returns: the index of the device to read next
+uint8_t MB4Bus::nextDevice(){
+   uint8_t best = 0;
+   for(uint8_t index = 0; index < this->numDevices; index++){
+      this->devices[index].credit += this->devices[index].weight;
+      if (this->devices[index].credit > this->devices[best].credit) {
+         best = index;
+      }
+   }
+   this->devices[best].credit -= this->totalWeight;
+   return best;
+}
+
+// service: runs one round of reads. All the reads of the round share one
+//          SPI.beginTransaction(), with only the chip selects changing 
+//          between accesses. Each picked driver first checks STATUS_REG for
+//          the end of a cycle and is only read if there is a new frame, so 
+//          the same frame is never read or counted twice. This should be 
+//          called as often as possible from loop().
+// Parameters: none
+// returns: nothing
+void MB4Bus::service(){
+   if (this->numDevices == 0) {
+      return;
+   }
+
+   uint32_t roundStart = micros();
+
+   // Hold one transaction open for every driver in the round
+   SPI.beginTransaction(this->spiSettings);
+   MB4Driver::batchOpen = true;
+
+   for(uint8_t pick = 0; pick < this->totalWeight; pick++){
+      Device& device = this->devices[this->nextDevice()];
+
+      uint32_t readStart = micros();
+      if (device.driver->checkCycleEnd()) {
+         device.driver->getRawPosition();
+         device.samples++;
+      }
+      else {
+         device.skipped++;
+      }
+      device.busyMicros += micros() - readStart;
+   }
+
+   MB4Driver::batchOpen = false;
+   SPI.endTransaction();
+
+   this->busyMicros += micros() - roundStart;
+}
+
+// beginSynchronized: switches every device over to synchronized capture. 
+//                    AGS is stopped so that cycles only start when 
+//                    captureSynchronized() starts them, and any cycle already
+//                    on the line is waited out. service() should not be used
+//                    until endSynchronized().
+// Parameters: none
+// returns: false if every slave wouldn't fit in a SyncCapture
+bool MB4Bus::beginSynchronized(){
+   uint8_t numFrames = 0;
+   for(uint8_t index = 0; index < this->numDevices; index++){
+      numFrames += this->devices[index].driver->getSlaveCount();
+   }
+   if (numFrames > SYNC_MAX_FRAMES) {
+      return false;
+   }
+
+   for(uint8_t index = 0; index < this->numDevices; index++){
+      this->devices[index].driver->writeFields(MB4Fields::Ags::set(0));
+   }
+
+   // Let the last automatic cycles finish, then clear the EOT they latched
+   delayMicroseconds(SYNC_CYCLE_TIMEOUT);
+   for(uint8_t index = 0; index < this->numDevices; index++){
+      MB4Driver* driver = this->devices[index].driver;
+      driver->checkCycleEnd();
+      driver->cycleEnded = false;
+   }
+
+   return true;
+}
+
+// captureSynchronized: captures every slave of every device at the same 
+//                      instant. Within one MB4 both channels already start 
+//                      their cycles together. Across MB4s the INIT 
+//                      instructions that start the cycles are sent back to 
+//                      back in a single SPI transaction with interrupts held
+//                      off, so they are apart by only the time it takes to 
+//                      send them, which is given as the skew. Once every 
+//                      cycle has ended the frames are all read in the same 
+//                      transaction and given the one timestamp.
+// Parameters: 
+// capture: the capture to fill in
+// returns: false if a cycle did not end within SYNC_CYCLE_TIMEOUT, in which
+//          case the frames of that device are left out
+bool MB4Bus::captureSynchronized(SyncCapture& capture){
+   uint32_t captureStart = micros();
+
+   SPI.beginTransaction(this->spiSettings);
+   MB4Driver::batchOpen = true;
+
+   // Start every cycle as close together as possible
+   uint8_t oldSREG = SREG;
+   cli();
+   uint32_t firstStart = micros();
+   for(uint8_t index = 0; index < this->numDevices; index++){
+      MB4Driver* driver = this->devices[index].driver;
+      driver->writeInstruction(driver->readCachedRegister(INSTR) | INIT);
+   }
+   uint32_t lastStart = micros();
+   SREG = oldSREG;
+
+   capture.timestamp = firstStart + (lastStart - firstStart) / 2;
+   capture.skew = lastStart - firstStart;
+
+   // Wait for each cycle to end and read its frames. The cycles all started 
+   // together, so waiting on one also waits on the others.
+   bool complete = true;
+   capture.numFrames = 0;
+   for(uint8_t index = 0; index < this->numDevices; index++){
+      Device& device = this->devices[index];
+      MB4Driver* driver = device.driver;
+      capture.firstFrame[index] = capture.numFrames;
+
+      uint32_t readStart = micros();
+      while (!driver->checkCycleEnd()) {
+         if (micros() - lastStart >= SYNC_CYCLE_TIMEOUT) {
+            break;
+         }
+      }
+      if (!driver->cycleEnded) {
+         complete = false;
+         continue;
+      }
+
+      MB4Driver::PositionFrame* frames = capture.frames + capture.numFrames;
+      driver->readFrames(frames, driver->getSlaveCount());
+      capture.numFrames += driver->getSlaveCount();
+
+      // Keep the driver's own position up to date, as getRawPosition() would
+      if (driver->checkStatus(frames[0].encoderStatus, frames[0].svalid == 2) == 
+          MB4Driver::no_errors) {
+         driver->currentRawPosition = frames[0].rawPosition;
+      }
+
+      device.busyMicros += micros() - readStart;
+      device.samples++;
+   }
+
+   MB4Driver::batchOpen = false;
+   SPI.endTransaction();
+
+   this->busyMicros += micros() - captureStart;
+   return complete;
+}
+
+// endSynchronized: goes back to the automatic cycles of each device, ready 
+//                  for service()
+// Parameters: none
+// returns: nothing
+void MB4Bus::endSynchronized(){
+   for(uint8_t index = 0; index < this->numDevices; index++){
+      this->devices[index].driver->writeFields(MB4Fields::Ags::set(1));
+   }
+}
+
+// getSamples: gets the number of new frames read from a device since the 
+//             statistics were reset
+// Parameters:
+// device: the index of the device, in the order they were added
+// returns: the number of new frames read
+uint32_t MB4Bus::getSamples(uint8_t device){
+   return (device < this->numDevices) ? this->devices[device].samples : 0;
+}
+
+// getSkipped: gets the number of times a device was picked with no new frame
+//             to read since the statistics were reset
+// Parameters:
+// device: the index of the device, in the order they were added
+// returns: the number of picks skipped
+uint32_t MB4Bus::getSkipped(uint8_t device){
+   return (device < this->numDevices) ? this->devices[device].skipped : 0;
+}
+
+// getSampleRate: gets the rate that new frames have been read from a device 
+//                at since the statistics were reset
+// Parameters:
+// device: the index of the device, in the order they were added
+// returns: the sample rate in samples per second
+float MB4Bus::getSampleRate(uint8_t device){
+   uint32_t elapsed = micros() - this->statisticsStart;
+   if (device >= this->numDevices || elapsed == 0) {
+      return 0;
+   }
+   return (float)(this->devices[device].samples) * 1000000.0 / elapsed;
+}
+
+// getUtilization: gets how busy the bus has been with rounds of reads since 
+//                 the statistics were reset
+// Parameters: none
+// returns: the percentage of time spent in service()
+float MB4Bus::getUtilization(){
+   uint32_t elapsed = micros() - this->statisticsStart;
+   if (elapsed == 0) {
+      return 0;
+   }
+   return (float)(this->busyMicros) * 100.0 / elapsed;
+}
+
+// resetStatistics: starts counting reads and bus time over from now
+// Parameters: none
+// returns: nothing
+void MB4Bus::resetStatistics(){
+   for(uint8_t index = 0; index < this->numDevices; index++){
+      this->devices[index].samples = 0;
+      this->devices[index].skipped = 0;
+      this->devices[index].busyMicros = 0;
+   }
+   this->busyMicros = 0;
+   this->statisticsStart = micros();
+}
+
+// printStatistics: prints the sample rate and bus time of every device, along
+//                  with the utilization of the whole bus
+// Parameters: none
+// returns: nothing (the print to standard out is what results)
+void MB4Bus::printStatistics(){
+   Serial.println("------ MB4 Bus Statistics ------");
+   for(uint8_t index = 0; index < this->numDevices; index++){
+      Serial.print("Device ");
+      Serial.print(index);
+      Serial.print(":\t");
+      Serial.print(this->getSampleRate(index), 1);
+      Serial.print(" samples/s\t");
+      Serial.print(this->devices[index].skipped);
+      Serial.print(" skipped\t");
+      Serial.print(this->devices[index].busyMicros);
+      Serial.println(" us busy");
+   }
+   Serial.print("Bus utilization: \t");
+   Serial.print(this->getUtilization(), 1);
+   Serial.println(" %");
+}
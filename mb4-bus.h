@@ -0,0 +1,151 @@
+/* mb4-bus.h
+   Class for sharing one SPI bus between several IC-MB4 master ICs.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MB4_BUS_H
+#define MB4_BUS_H
+
+#include "mb4-driver.h"
+
+// The most MB4 chips that can share one bus
+#define MAX_BUS_DEVICES    4
+
+// The most frames, over every slave of every device, that one synchronized 
+// capture holds
+#ifndef SYNC_MAX_FRAMES
+#define SYNC_MAX_FRAMES    4
+#endif
+
+// Longest time a cycle started for a synchronized capture may take before it
+// is given up on, in microseconds
+#define SYNC_CYCLE_TIMEOUT   1000
+
+// SyncCapture: the frames of every slave of every device on a bus, all 
+//              latched by the encoders at the same instant
+struct SyncCapture
+{
+   uint32_t timestamp;     // micros() halfway through starting the cycles
+   uint16_t skew;          // Time from starting the first cycle to the last,
+                           // in microseconds
+   uint8_t numFrames;      // Number of frames captured
+   uint8_t firstFrame[MAX_BUS_DEVICES]; // Index of each device's first frame
+   MB4Driver::PositionFrame frames[SYNC_MAX_FRAMES]; // In device order, 
+                           // each device's slaves as readPositionFrames()
+};
+
+// MB4Bus class: a scheduler for reading several MB4Drivers that share one SPI
+//               bus, each with its own chip select pin. Every call to 
+//               service() runs one round of reads under a single 
+//               SPI.beginTransaction(), so the bus is set up once per round 
+//               rather than once per register access. Within a round each 
+//               driver is picked as many times as its weight, with the picks
+//               of different drivers interleaved (smooth weighted round 
+//               robin) so that a heavily weighted driver is not read twice in
+//               a row when it doesn't have to be. A picked driver is only 
+//               read if its MB4 has finished a new cycle, so the bus time of
+//               a frame that would be read again goes to the other drivers.
+//               The scheduler keeps track of the rate of new frames from 
+//               each driver and how busy the bus is.
+//
+// For measurements that must line up in time, such as the difference in 
+// volume of two accumulators, the bus can instead capture every slave of 
+// every device at the same instant with captureSynchronized().
+//
+// Drivers that are capturing with beginInterruptAcquisition() should not be
+// added, since the interrupt already reads them.
+class MB4Bus {
+   private:
+      // Scheduling and statistics for one driver on the bus
+      struct Device
+      {
+         MB4Driver* driver;
+         uint8_t weight;         // Reads per round
+         int16_t credit;         // Running credit for the round robin
+         uint32_t samples;       // New frames read since the statistics 
+                                 // were reset
+         uint32_t skipped;       // Picks with no new frame to read
+         uint32_t busyMicros;    // Time spent reading this driver
+      } devices[MAX_BUS_DEVICES];
+
+      uint8_t numDevices;
+
+      // Sum of the weights of all devices, the number of reads in a round
+      uint8_t totalWeight;
+
+      // When the statistics were last reset, and the time spent in rounds 
+      // since then
+      uint32_t statisticsStart;
+      uint32_t busyMicros;
+
+      // The SPI settings for a round, at the clock of the slowest driver
+      SPISettings spiSettings;
+
+      uint8_t nextDevice();
+
+   public:
+      MB4Bus();
+
+      bool addDevice(MB4Driver* driver, uint8_t weight = 1);
+
+      void service();
+
+      bool beginSynchronized();
+
+      bool captureSynchronized(SyncCapture& capture);
+
+      void endSynchronized();
+
+      void updateSPISettings();
+
+      uint32_t getSamples(uint8_t device);
+
+      uint32_t getSkipped(uint8_t device);
+
+      float getSampleRate(uint8_t device);
+
+      float getUtilization();
+
+      void resetStatistics();
+
+      void printStatistics();
+};
+
+#endif
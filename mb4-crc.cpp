@@ -0,0 +1,87 @@
+/* mb4-crc.cpp
+   Source code for a table driven CRC check of BiSS frames.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Include the header file which has all of the prototypes of the functions
+// contained in this source file.
+#include "mb4-crc.h"
+
+// Builds the 256 entry lookup table out of crc6Entry(), 4 entries at a time
+#define CRC6_ENTRIES_4(n)    crc6Entry(n), crc6Entry(n + 1), crc6Entry(n + 2), crc6Entry(n + 3)
+#define CRC6_ENTRIES_16(n)   CRC6_ENTRIES_4(n), CRC6_ENTRIES_4(n + 4), \
+                             CRC6_ENTRIES_4(n + 8), CRC6_ENTRIES_4(n + 12)
+#define CRC6_ENTRIES_64(n)   CRC6_ENTRIES_16(n), CRC6_ENTRIES_16(n + 16), \
+                             CRC6_ENTRIES_16(n + 32), CRC6_ENTRIES_16(n + 48)
+
+// Lookup table of the CRC of every byte, with the CRC in the top 6 bits. The
+// table is generated by the compiler and kept in flash.
+static const uint8_t crc6Table[256] PROGMEM = {
+   CRC6_ENTRIES_64(0), CRC6_ENTRIES_64(64), CRC6_ENTRIES_64(128), CRC6_ENTRIES_64(192)
+};
+
+// bissCRC6: works out the BiSS CRC of a string of bytes, most significant 
+//            bit first. Leading zero bits don't change the CRC, so data that 
+//            isn't a whole number of bytes can be padded with zeros at the 
+//            front.
+// Parameters:
+// data: the bytes to work out the CRC of, first byte first
+// length: the number of bytes
+// returns: the 6 bit CRC, before the inversion that BiSS applies when sending
+uint8_t bissCRC6(const uint8_t* data, uint8_t length){
+   uint8_t crc = 0;
+   for(uint8_t i = 0; i < length; i++){
+      crc = pgm_read_byte(&crc6Table[crc ^ data[i]]);
+   }
+   return crc >> 2;
+}
+
+// bissCRC6: works out the BiSS CRC of the data bits of one frame
+// Parameters:
+// frameData: the BISS_CRC6_DATA_BITS data bits of the frame, position and 
+//            encoder status bits, right aligned
+// returns: the 6 bit CRC, before the inversion that BiSS applies when sending
+uint8_t bissCRC6(uint32_t frameData){
+   uint8_t crc = pgm_read_byte(&crc6Table[(uint8_t)(frameData >> 24)]);
+   crc = pgm_read_byte(&crc6Table[crc ^ (uint8_t)(frameData >> 16)]);
+   crc = pgm_read_byte(&crc6Table[crc ^ (uint8_t)(frameData >> 8)]);
+   crc = pgm_read_byte(&crc6Table[crc ^ (uint8_t)(frameData)]);
+   return crc >> 2;
+}
@@ -0,0 +1,79 @@
+/* mb4-crc.h
+   Table driven CRC check of the BiSS frames read from an IC-MB4 master IC.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MB4_CRC_H
+#define MB4_CRC_H
+
+#include <Arduino.h>
+
+// The BiSS CRC polynomial x^6 + x^1 + x^0, without the x^6 term. This is the
+// polynomial the MB4 checks against with CRC_SELECT 0 and CRC_POLY 6.
+#define BISS_CRC6_POLY   0x03
+
+// Number of data bits covered by the CRC of a frame: the position and the 
+// encoder status bits (DATA_LENGTH + 1)
+#define BISS_CRC6_DATA_BITS   28
+
+// The CRC is worked out a byte at a time with the 6 CRC bits held at the top 
+// of a byte. These work out each entry of the lookup table at compile time.
+
+// crc6Shift: shifts a single bit out of the top of the CRC
+constexpr uint8_t crc6Shift(uint8_t crc){
+   return (crc & 0x80) ? (uint8_t)((crc << 1) ^ (BISS_CRC6_POLY << 2)) 
+                       : (uint8_t)(crc << 1);
+}
+
+// crc6Bits: shifts count bits out of the top of the CRC
+constexpr uint8_t crc6Bits(uint8_t crc, uint8_t count){
+   return (count == 0) ? crc : crc6Bits(crc6Shift(crc), count - 1);
+}
+
+// crc6Entry: the lookup table entry for a byte
+constexpr uint8_t crc6Entry(uint8_t value){
+   return crc6Bits(value, 8);
+}
+
+uint8_t bissCRC6(const uint8_t* data, uint8_t length);
+
+uint8_t bissCRC6(uint32_t frameData);
+
+#endif
@@ -44,150 +44,360 @@
 // contained in this source file.
 #include "mb4-driver.h"
 
+// countUp: adds one to a count, stopping at the largest value it can hold
+static void countUp(uint16_t& count){
+   if (count != 0xFFFF) {
+      count++;
+   }
+}
+
 // For class description, please refer to the header file. This is the first 
 // place to start for a general overview of the methods available, and can 
 // provide a general idea of the methods available in this class. 
 
+// Correction of the strip used until another calibration is loaded. The 
+// position jumps if the encoder goes off the strip: to just under 100 in when
+// barely going off, and by 200 in at the far end. In units where those 
+// distances don't fit in a position_t (nanometres) such positions can't be 
+// reached anyway, so nothing is corrected.
+#define STRIP_CALIBRATION_MAX_INCHES   200
+
+#if STRIP_CALIBRATION_MAX_INCHES * POSITION_UNITS_PER_INCH <= 2147483647
+static_assert(INCHES_FIT_POSITION(STRIP_CALIBRATION_MAX_INCHES), 
+              "the strip calibration must fit in a position_t");
+
+static const CalibrationSegment stripCalibration[] PROGMEM = {
+   {CALIBRATION_MIN_POSITION,            0,                            0},
+   {INCHES_TO_POSITION(10.0) + 1,        -INCHES_TO_POSITION(85.60),   0},
+   {INCHES_TO_POSITION(100),             0,                            0},
+   {INCHES_TO_POSITION(190) + 1,         -INCHES_TO_POSITION(STRIP_CALIBRATION_MAX_INCHES), 0}
+};
+#else
+static const CalibrationSegment stripCalibration[] PROGMEM = {
+   {CALIBRATION_MIN_POSITION,            0,                            0}
+};
+#endif
+
+// The driver that is currently capturing frames on the end of transmission 
+// interrupt (only one driver can do so at a time)
+MB4Driver* MB4Driver::acquiringDriver = 0;
+
+// No MB4Bus is holding a transaction open to begin with
+bool MB4Driver::batchOpen = false;
+
 
 // MB4Driver: Constructor for the MB4Driver class
 // Parameters: 
 // selectPin: the SPI chip select pin that the mb4 is connected to
 // offset: (optional parameter) the offset in inches for the encoder readings
-MB4Driver::MB4Driver(uint8_t selectPin, float offset=0){
+// channel1Slaves: (optional parameter) the number of slaves on Channel 1
+// channel2Slaves: (optional parameter) the number of slaves on Channel 2, 
+//                 Channel 2 is only enabled if this is not 0. Together with 
+//                 Channel 1 there can be at most MAX_SLAVES.
+// verbose: (optional parameter) print the configuration and first reading 
+//          over Serial once the MB4 is set up
+MB4Driver::MB4Driver(uint8_t selectPin, float offset=0, uint8_t channel1Slaves, 
+                     uint8_t channel2Slaves, bool verbose){
+   this->selectPin = selectPin;
+   this->verbose = verbose;
+
+   // Talk to the MB4 at the default clock until told otherwise
+   this->setSPIClock(SPI_CLOCK);
+
+   // Read the encoders at the default MA clock and cycle period until told
+   // otherwise, at that rate all the time
+   this->freqS = CLOCK_SPEED;
+   this->freqAgs = AGSFREQ;
+   this->adaptiveFastPeriod = 0;
+
+   // Nothing is known about the registers of the MB4 yet
+   this->invalidateShadow();
+   this->configured = false;
+
+   // Store the offset from 0 for this encoder
+   this->offset = offset;
+   this->offsetFixed = (position_t)(offset * POSITION_UNITS_PER_INCH);
+
+   // Correct for the strip until a calibration is loaded or captured
+   this->calibration.loadProgmem(stripCalibration, 
+                                 sizeof(stripCalibration) / sizeof(stripCalibration[0]));
+
+   // Store how the slaves are spread over the channels, keeping the total 
+   // within what the MB4 has banks for
+   if (channel1Slaves > MAX_SLAVES) {
+      channel1Slaves = MAX_SLAVES;
+   }
+   if (channel2Slaves > MAX_SLAVES - channel1Slaves) {
+      channel2Slaves = MAX_SLAVES - channel1Slaves;
+   }
+   this->channel1Slaves = channel1Slaves;
+   this->channel2Slaves = channel2Slaves;
+
+   // Read frames with the regular READ_DATA command unless asked otherwise
+   this->fastAccess = false;
+
+   // Trust the CRC check of the MB4 unless asked otherwise
+   this->softwareCRC = false;
+
+   // Frames are polled until interrupt acquisition is started
+   this->acquisitionBuffer = 0;
+   this->acquisitionInterrupt = NOT_AN_INTERRUPT;
+   this->observer = 0;
+   this->decimator = 0;
+
+   // No cycle has been waited for
+   this->cycleEnded = false;
+
+   // No register communication has been requested
+   this->transferState = transfer_idle;
+   this->transferStatus = 0;
+
+   // Nothing has been read from the encoder yet
+   this->currentStatus = no_errors;
+   this->currentRawPosition = 0;
+   memset(&this->health, 0, sizeof(this->health));
+   memset(&this->telemetry, 0, sizeof(this->telemetry));
+
+   // Nothing is talked to until begin() is called
+   this->currentStep = startup_idle;
+}
+
+// begin: starts up the MB4. The hardware used by the driver is set up here,
+//        and the rest of the start up is done one step at a time by poll(), 
+//        so that loop() can carry on with other work meanwhile. 
+// Parameters: None
+// returns: nothing
+void MB4Driver::begin(){
    // Begin the SPI communication protocol that will be used to 
    // communicate with the IC-mb4 chip
    SPI.begin();
 
+   // Count starting up again after a failed or interrupted start up
+   if (this->currentStep != startup_idle) {
+      countUp(this->telemetry.retries);
+   }
+
    // Setup the necessary serial communication for this library
    if(!Serial){
       Serial.begin(9600);
    }
 
-   this->selectPin = selectPin;
-
    // Setup Pin 10 to be a digital output for slave select
    pinMode(this->selectPin, OUTPUT);
 
    // Set the select pin high so that communication is not yet enabled
    digitalWrite(this->selectPin, 1);
 
-   // Store the offset from 0 for this encoder
-   this->offset = offset;
-
-   // Tell master to stop any previous processes and start fresh
-   this->writeInstruction(BREAK);
-
-   // Set the Channel 1 as the only active channel
-   this->writeRegister(CHSEL, CH1);
-
-   // Set up the channel as BiSS register configuration
-   this->writeRegister(REGVERS, BISS_C << 6);
+   this->currentStep = startup_break;
+}
 
-   // Set the FREQ register bit 4:0 to communicate with encoder
-   uint8_t currentFREQ = this->readRegister(FREQ, 1);
-   currentFREQ &= ~(0b00011111);
-   currentFREQ |= CLOCK_SPEED;
-   this->writeRegister(FREQ, currentFREQ);
-   Serial.print("FREQ: \t\t");
-   Serial.println(this->readRegister(FREQ, 1));
+// poll: runs the next step of starting up the MB4, each of which only takes
+//       a few SPI transactions. The steps are: BREAK, upload the 
+//       configuration, enable AGS, then wait for the first valid frame. This
+//       should be called from loop() until it returns true (or hasFailed() 
+//       does).
+// Parameters: None
+// returns: true once the MB4 is ready for readings
+bool MB4Driver::poll(){
+   switch (this->currentStep) {
+      case startup_break:
+         // Tell master to stop any previous processes and start fresh
+         this->writeInstruction(BREAK);
+         this->currentStep = startup_configure;
+         break;
+
+      case startup_configure:
+         // Upload the whole configuration in a few bursts and check it took
+         this->configured = this->uploadConfiguration();
+         this->currentStep = startup_enable_ags;
+         break;
+
+      case startup_enable_ags:
+         // Enable the AGS (Automatic Get Sensor) bit so that the MB4 now polls
+         // encoder
+         this->writeFields(MB4Fields::Ags::set(1));
+         this->startupTime = millis();
+         this->currentStep = startup_wait_frame;
+         break;
+
+      case startup_wait_frame:
+         // Wait only as long as it takes for the first valid reading of the 
+         // first slave to arrive
+         if ((this->readRegister(SVALID, 1) & 0b00000011) == 2) {
+            this->finishStartup();
+            this->currentStep = startup_ready;
+         }
+         else if (millis() - this->startupTime >= FIRST_FRAME_TIMEOUT) {
+            this->currentStep = startup_failed;
+            if (this->verbose) {
+               Serial.println("MB4 FIRST FRAME TIMEOUT");
+            }
+         }
+         break;
+
+      default:
+         break;
+   }
 
-   // Set up the communication for BiSS C protocol
-   uint8_t currentCFGCH1 = this->readRegister(CFGCH1, 1);
-   currentCFGCH1 &= ~(0b00001111);
-   currentCFGCH1 |= BISS_C;
-   this->writeRegister(CFGCH1, currentCFGCH1);
-   Serial.print("CFGCH1: \t");
-   Serial.println(this->readRegister(CFGCH1, 1));
+   return this->currentStep == startup_ready;
+}
 
-   // Set up for automatically starting read cycles
-   this->writeRegister(FREQAGS, AGSFREQ);
-   Serial.print("FREQAGS: \t");
-   Serial.println(this->readRegister(FREQAGS, 1));
+// finishStartup: the last step of starting up, once the first valid frame 
+//                has arrived
+// Parameters: None
+// returns: nothing
+void MB4Driver::finishStartup(){
+   if (this->verbose) {
+      // Notify user that MB4Driver is instantiated
+      Serial.println("MB4Driver Instantiated");
+      if (!this->configured) {
+         Serial.println("MB4 CONFIGURATION MISMATCH");
+      }
+
+      // Notify user of version of the MB4 IC and how it is configured
+      this->printVersion();
+      this->printImportantRegisters();
+
+      // Print out all the initial registers for SCDATA1
+      this->printSCDATA1Registers();
+   }
 
-   // Set up for RS422 Line levels in CFGIF bit 3:2
-   uint8_t currentCFGIF = this->readRegister(CFGIF, 1);
-   currentCFGIF &= ~(0b00001111);
-   currentCFGIF |= (RS422 << 2);
-   // Enable the internal clock sou~rce 
-   currentCFGIF |= (1);
-   this->writeRegister(CFGIF, currentCFGIF);
-   Serial.print("CFGIF: \t\t");
-   Serial.println(this->readRegister(CFGIF, 1));
-
-      // Configure the data length of the SCD. bit 5:0 SCDLEN1
-   uint8_t currentSCDLEN1 = this->readRegister(SCDLEN1, 1);
-   currentSCDLEN1 &= ~(0b11111111);
-   currentSCDLEN1 |= (DATA_LENGTH);
-   currentSCDLEN1 |= (SCD_AVAIL << 6);
-   this->writeRegister(SCDLEN1, currentSCDLEN1);
-   Serial.print("SCDLEN1 & ENSCD1: \t");
-   Serial.println(this->readRegister(SCDLEN1, 1));
-
-   // Configure the CRC info
-   this->writeRegister(SELCRCS1, (CRC_SELECT << 7) | CRC_POLY);
-   Serial.print("SELCRCS1: \t");
-   Serial.println(this->readRegister(SELCRCS1, 1));
-
-   // Configure the CRC start 
-   uint8_t crcStartToSend[2];
-   crcStartToSend[0] = CRC_START;
-   crcStartToSend[1] = CRC_START;
-   this->writeRegister(SCRCSTART1, crcStartToSend, 2);
-   Serial.print("SCRCSTART1: \t");
-   Serial.println(this->readRegister(SCRCSTART1, 2));
+   // Take the first raw position reading
+   this->getRawPosition();
+}
 
-   // Configure all slaves to be sensors
-   this->writeRegister(ACTnSENS, SLAVES);
-   Serial.print("ACTnSENS: \t");
-   Serial.println(this->readRegister(ACTnSENS, 1));
+// isReady: checks if the MB4 has finished starting up
+// Parameters: None
+// returns: true once the first valid frame has arrived
+bool MB4Driver::isReady(){
+   return this->currentStep == startup_ready;
+}
 
-   // Enable the AGS (Automatic Get Sensor) bit so that the MB4 now polls
-   // encoder
-   uint8_t currentInstruction = this->readRegister(INSTR, 1);
-   currentInstruction |= 1;
-   this->writeInstruction(currentInstruction);
-   Serial.print("INSTR: \t ");
-   Serial.println(this->readRegister(INSTR, 1), BIN);
+// hasFailed: checks if starting up the MB4 failed, in which case begin() 
+//            can be called to try again
+// Parameters: None
+// returns: true if no valid frame arrived in time
+bool MB4Driver::hasFailed(){
+   return this->currentStep == startup_failed;
+}
 
-   // Notify user that MB4Driver is instantiated
-   Serial.println("MB4Driver Instantiated");
+// stageRegister: sets the value of a register in the shadow copy only, ready
+//                for uploadConfiguration() to write it to the MB4
+// Parameters:
+// registerAddress: the address of the register, which must be shadowed
+// data: the value to stage for the register
+// returns: nothing
+void MB4Driver::stageRegister(uint8_t registerAddress, uint8_t data){
+   this->shadowRegisters[registerAddress - SHADOW_START] = data;
+}
 
-   // Notify user of version of the MB4 IC
-   this->printVersion();
+// uploadConfiguration: configures the MB4 for reading the encoders. The 
+//                      configuration is first staged in the shadow copy, then
+//                      uploaded in three bursts: the slave configuration, the
+//                      master configuration from CHSEL to ACTnSENS, and CFGIF.
+//                      The configuration registers are then read back in a 
+//                      single block and compared against what was uploaded.
+// Parameters: None
+// returns: true if the MB4 holds the configuration that was uploaded
+bool MB4Driver::uploadConfiguration(){
+   // Start from what the MB4 holds, so that the bits not configured here 
+   // are written back unchanged
+   this->resync();
 
-   // Give Time to collect the first reading
-   delay(1000);
+   // Set the Channel 1 as active, along with Channel 2 if it has slaves
+   this->stageFields(MB4Fields::ChSel::set((this->channel2Slaves > 0) ? (CH1 | CH2) : CH1));
 
-   // Print out all the initial registers for SCDATA1
-   Serial.print("00:\t");
-   Serial.print(this->readRegister(0x00, 1), HEX);
+   // Set up the channel as BiSS C register configuration, with the rest of 
+   // REGVERS cleared
+   this->stageRegister(REGVERS, MB4Fields::RegVers::set(REGVERS_BISS_C).bits);
 
-   Serial.print("\t01: ");
-   Serial.print(this->readRegister(0x01, 1), HEX);
+   // Set the FREQ register bit 4:0 to communicate with encoder
+   this->stageFields(MB4Fields::FreqS::set(this->freqS));
 
-   Serial.print("\t02: ");
-   Serial.print(this->readRegister(0x02, 1), HEX);
+   // Set up the communication for BiSS C protocol
+   this->stageFields(MB4Fields::CfgCh1::set(BISS_C));
+   if (this->channel2Slaves > 0) {
+      this->stageFields(MB4Fields::CfgCh2::set(BISS_C));
+   }
 
-   Serial.print("\t03: ");
-   Serial.print(this->readRegister(0x03, 1), HEX);
+   // Set up for automatically starting read cycles
+   this->stageFields(MB4Fields::FreqAgs::set(this->freqAgs));
 
-   Serial.print("\t04: ");
-   Serial.print(this->readRegister(0x04, 1), HEX);
+   // Set up for RS422 Line levels in CFGIF bit 3:2
+   // and enable the internal clock source in bit 1:0
+   this->stageFields(MB4Fields::CfgIfLevel::set(RS422) | MB4Fields::CfgIfClock::set(1));
 
-   Serial.print("\t05: ");
-   Serial.print(this->readRegister(0x05, 1), HEX);
+   // Configure all slaves to be sensors
+   this->stageFields(MB4Fields::ActSens::set(SLAVES));
+
+   // Configure the data length of the SCD and the CRC of every slave
+   this->stageSlaveConfig<0>(this->getSlaveCount());
+
+   // Keep the image of what is being uploaded to check against later
+   uint8_t image[STATUS_REG - SHADOW_START];
+   memcpy(image, this->shadowRegisters, sizeof(image));
+   uint8_t cfgif = this->shadowRegisters[CFGIF - SHADOW_START];
+
+   // Upload the configuration, only as much of the slave configuration 
+   // as there are slaves
+   this->writeRegister(SCDLEN1, image, this->getSlaveCount()*SLAVE_CONFIG_SIZE);
+   // CHSEL to ACTnSENS is not written as one block, since REVISION, VERSION
+   // and the reserved registers between them are read only
+   this->writeRegister(CHSEL, image + (CHSEL - SHADOW_START), FREQ - CHSEL + 1);
+   this->writeRegister(FREQAGS, image[FREQAGS - SHADOW_START]);
+   this->writeRegister(CFGCH2, image + (CFGCH2 - SHADOW_START), CFGCH1 - CFGCH2 + 1);
+   this->writeRegister(ACTnSENS, image[ACTnSENS - SHADOW_START]);
+   this->writeRegister(CFGIF, cfgif);
+
+   // Read the configuration back and compare it against the image. The 
+   // slave configuration and master configuration are contiguous, so a 
+   // single block covers both.
+   uint8_t readback[sizeof(image)];
+   this->readRegister(SHADOW_START, readback, sizeof(readback));
+
+   return (memcmp(readback, image, sizeof(image)) == 0) && 
+          (this->readRegister(CFGIF, 1) == cfgif);
+}
 
-   Serial.print("\t06: ");
-   Serial.print(this->readRegister(0x06, 1), HEX);
+// isConfigured: checks whether the configuration uploaded while starting up
+//               was read back correctly
+// Parameters: None
+// returns: true if the MB4 holds the driver's configuration
+bool MB4Driver::isConfigured(){
+   return this->configured;
+}
 
-   Serial.print("\t07: ");
-   Serial.println(this->readRegister(0x07, 1), HEX);
+// beginTransfer: starts an SPI transaction with the MB4 and selects it. The 
+//                transaction is started before the chip select drops so that
+//                an acquisition interrupt can't start its own transaction part
+//                way through this one. When an MB4Bus already holds a 
+//                transaction open for a batch of reads, only the chip select 
+//                is changed.
+// Parameters: None
+// returns: nothing
+void MB4Driver::beginTransfer(){
+   // Configure the correct SPI settings to be used
+   if (!batchOpen) {
+      SPI.beginTransaction(this->spiSettings);
+   }
 
-   // Print the first raw position reading
-   this->getRawPosition();
+   // Drop the chip select pin low to select MB4 for output
+   digitalWrite(this->selectPin, 0);
+}
 
-   //this->printImportantRegisters();
+// endTransfer: deselects the MB4 and ends the SPI transaction, unless an 
+//              MB4Bus is holding it open
+// Parameters: None
+// returns: nothing
+void MB4Driver::endTransfer(){
+   // Bring chip select high to stop communication with MB4
+   digitalWrite(this->selectPin, 1);
 
+   // End the SPI transaction for nice cooperation with other 
+   // SPI dependent libraries
+   if (!batchOpen) {
+      SPI.endTransaction();
+   }
 }
 
 // readRegister: Function for reading a specific register on the MB4
@@ -197,11 +407,9 @@ MB4Driver::MB4Driver(uint8_t selectPin, float offset=0){
 // returns: the value read from the register address assuming that the 
 //          first register read is the most significant byte
 uint32_t MB4Driver::readRegister(uint8_t registerAddress, uint8_t numBytesToRead){
-   // Drop the chip select pin low to select MB4 for output
-   digitalWrite(this->selectPin, 0);
-
-   // Configure the correct SPI settings to be used
-   SPI.beginTransaction(SPISettings(1000000,MSBFIRST,SPI_MODE0));
+   // Start the transaction and select the MB4 for output
+   this->beginTransfer();
+   MB4_TRACE_BEGIN(READ_DATA, registerAddress);
 
    // Send the read command 
    SPI.transfer(READ_DATA);
@@ -219,22 +427,56 @@ uint32_t MB4Driver::readRegister(uint8_t registerAddress, uint8_t numBytesToRead
    for(int i=0; i<numBytesToRead; i++){
       buffer = SPI.transfer(0);
       // Arrage the bytes for a proper number to return
-      value *= 2^8;
+      value <<= 8;
 
       value +=buffer;
-   }
 
-   // Bring chip select high to stop communication with MB4
-   digitalWrite(this->selectPin, 1);
+      // Keep the shadow copy of the register up to date
+      this->updateShadow(registerAddress + i, buffer);
+   }
 
-   // End the SPI transaction for nice cooperation with other 
-   // SPI dependent libraries
-   SPI.endTransaction();
+   // Deselect the MB4 and end the transaction
+   MB4_TRACE_END(2 + numBytesToRead);
+   this->endTransfer();
 
    return value;
 
 }
 
+// readRegister: Function for reading a block of consecutive registers on the 
+//               MB4 in a single SPI transaction (array version)
+// Parameters:
+// registerAddress: the register starting address to read from
+// data: an array of bytes to read into, in register order
+// numBytesToRead: the number of bytes to read into the array
+// returns: nothing (the values are placed into data)
+void MB4Driver::readRegister(uint8_t registerAddress, uint8_t* data, uint8_t numBytesToRead){
+   // Start the transaction and select the MB4 for output
+   this->beginTransfer();
+   MB4_TRACE_BEGIN(READ_DATA, registerAddress);
+
+   // Send the read command 
+   SPI.transfer(READ_DATA);
+
+   // Send the register address to start reading from 
+   SPI.transfer(registerAddress);
+
+   // The MB4 auto increments the address, so keep clocking out bytes
+   for(uint8_t i=0; i<numBytesToRead; i++){
+      data[i] = SPI.transfer(0);
+   }
+
+   // Deselect the MB4 and end the transaction
+   MB4_TRACE_END(2 + numBytesToRead);
+   this->endTransfer();
+
+   // Keep the shadow copy of the registers up to date
+   for(uint8_t i=0; i<numBytesToRead; i++){
+      this->updateShadow(registerAddress + i, data[i]);
+   }
+
+}
+
 // writeRegister: A function to write data to a register on the MB4 
 //                  (array version) 
 // Parameters:
@@ -242,11 +484,14 @@ uint32_t MB4Driver::readRegister(uint8_t registerAddress, uint8_t numBytesToRead
 // data: an array of bytes to write 
 // numBytesToWrite: the number of bytes in array pointer or data to write
 void MB4Driver::writeRegister(uint8_t registerAddress, uint8_t* data, uint8_t numBytesToWrite){
-   // Drop the chip select pin low to select MB4 for output
-   digitalWrite(this->selectPin, 0);
+   // Write through to the shadow copy
+   for(uint8_t i=0; i<numBytesToWrite; i++){
+      this->updateShadow(registerAddress + i, data[i]);
+   }
 
-   // Configure the correct SPI settings to be used
-   SPI.beginTransaction(SPISettings(1000000,MSBFIRST,SPI_MODE0));
+   // Start the transaction and select the MB4 for output
+   this->beginTransfer();
+   MB4_TRACE_BEGIN(WRITE_DATA, registerAddress);
 
    // Send the read command 
    SPI.transfer(WRITE_DATA);
@@ -254,15 +499,15 @@ void MB4Driver::writeRegister(uint8_t registerAddress, uint8_t* data, uint8_t nu
    // Send the register address to write to 
    SPI.transfer(registerAddress);
 
-   // Write the bytes
-   SPI.transfer(data, numBytesToWrite);
-
-   // Bring chip select high to stop communication with MB4
-   digitalWrite(this->selectPin, 1);
+   // Write the bytes one at a time, since the block transfer of the SPI 
+   // library would replace the contents of data with the bytes received
+   for(uint8_t i=0; i<numBytesToWrite; i++){
+      SPI.transfer(data[i]);
+   }
 
-   // End the SPI transaction for nice cooperation with other 
-   // SPI dependent libraries
-   SPI.endTransaction();
+   // Deselect the MB4 and end the transaction
+   MB4_TRACE_END(2 + numBytesToWrite);
+   this->endTransfer();
 
 }
 
@@ -272,11 +517,9 @@ void MB4Driver::writeRegister(uint8_t registerAddress, uint8_t* data, uint8_t nu
 // registerAddress: the starting address of the register to write to
 // data: the byte of data to be written to that address
 void MB4Driver::writeRegister(uint8_t registerAddress, uint8_t data){
-   // Drop the chip select pin low to select MB4 for output
-   digitalWrite(this->selectPin, 0);
-
-   // Configure the correct SPI settings to be used
-   SPI.beginTransaction(SPISettings(1000000,MSBFIRST,SPI_MODE0));
+   // Start the transaction and select the MB4 for output
+   this->beginTransfer();
+   MB4_TRACE_BEGIN(WRITE_DATA, registerAddress);
 
    // Send the read command 
    SPI.transfer(WRITE_DATA);
@@ -287,10 +530,12 @@ void MB4Driver::writeRegister(uint8_t registerAddress, uint8_t data){
    // Write the data
    SPI.transfer(data);
 
-   // Bring chip select high to stop communication with MB4
-   digitalWrite(this->selectPin, 1);
+   // Deselect the MB4 and end the transaction
+   MB4_TRACE_END(3);
+   this->endTransfer();
 
-   SPI.endTransaction();
+   // Write through to the shadow copy of the register
+   this->updateShadow(registerAddress, data);
 
 }
 
@@ -300,11 +545,9 @@ void MB4Driver::writeRegister(uint8_t registerAddress, uint8_t data){
 // instruction: The instruction to write to the MB4's instruction register
 // returns: nothing
 void MB4Driver::writeInstruction(uint8_t instruction){
-   // Drop the chip select pin low to select MB4 for output
-   digitalWrite(this->selectPin, 0);
-
-   // Configure the correct SPI settings to be used
-   SPI.beginTransaction(SPISettings(1000000,MSBFIRST,SPI_MODE0));
+   // Start the transaction and select the MB4 for output
+   this->beginTransfer();
+   MB4_TRACE_BEGIN(WRITE_INSTRUCTION, instruction);
 
    // Send the read command 
    SPI.transfer(WRITE_INSTRUCTION);
@@ -312,82 +555,979 @@ void MB4Driver::writeInstruction(uint8_t instruction){
    // Write the bytes
    SPI.transfer(instruction);
 
-   // Bring chip select high to stop communication with MB4
-   digitalWrite(this->selectPin, 1);
+   // Deselect the MB4 and end the transaction
+   MB4_TRACE_END(2);
+   this->endTransfer();
+
+   // A BREAK stops all processes, changing INSTR in ways that can't be 
+   // predicted here. Otherwise INIT resets itself once the cycle starts, and 
+   // the command bits once the command finishes, so neither is kept in the
+   // shadow copy where they would be sent again with the next instruction.
+   if (instruction & BREAK){
+      this->invalidateRegister(INSTR);
+   }
+   else {
+      this->updateShadow(INSTR, instruction & ~(INIT | INSTR_COMMAND_BITS));
+   }
+
+}
+
+// fastReadRegister: Function for reading the data banks using the fast access
+//                   READ_DATA0 command. Reading always starts at address 0x00
+//                   (SCDATA1), so no address byte needs to be sent.
+// Parameters:
+// data: an array of bytes to read into, starting with address 0x00
+// numBytesToRead: the number of bytes to read into the array
+// returns: nothing (the values are placed into data)
+void MB4Driver::fastReadRegister(uint8_t* data, uint8_t numBytesToRead){
+   // Start the transaction and select the MB4 for output
+   this->beginTransfer();
+   MB4_TRACE_BEGIN(READ_DATA0, SCDATA1);
+
+   // Send the fast read command, the data follows directly
+   SPI.transfer(READ_DATA0);
+
+   // Read the bytes, the MB4 auto increments the address
+   for(uint8_t i=0; i<numBytesToRead; i++){
+      data[i] = SPI.transfer(0);
+   }
+
+   // Deselect the MB4 and end the transaction
+   MB4_TRACE_END(1 + numBytesToRead);
+   this->endTransfer();
+
+}
+
+// fastWriteRegister: Function for writing the data banks using the fast 
+//                    access WRITE_DATA0 command. Writing always starts at 
+//                    address 0x00, so no address byte needs to be sent.
+// Parameters:
+// data: an array of bytes to write, starting with address 0x00
+// numBytesToWrite: the number of bytes in the array to write
+// returns: nothing
+void MB4Driver::fastWriteRegister(uint8_t* data, uint8_t numBytesToWrite){
+   // Start the transaction and select the MB4 for output
+   this->beginTransfer();
+   MB4_TRACE_BEGIN(WRITE_DATA0, SCDATA1);
+
+   // Send the fast write command, the data follows directly
+   SPI.transfer(WRITE_DATA0);
+
+   // Write the bytes one at a time, since the block transfer of the SPI 
+   // library would replace the contents of data with the bytes received
+   for(uint8_t i=0; i<numBytesToWrite; i++){
+      SPI.transfer(data[i]);
+   }
+
+   // Deselect the MB4 and end the transaction
+   MB4_TRACE_END(1 + numBytesToWrite);
+   this->endTransfer();
+
+}
+
+// setFastAccess: chooses how readPositionFrame() reads the SCDATA1 bank. The
+//                fast access path uses READ_DATA0 and saves the address byte
+//                on every sample. Locking the bank always uses 
+//                WRITE_INSTRUCTION, which already has no address byte.
+// Parameters:
+// enable: true to read frames with READ_DATA0, false to use READ_DATA
+// returns: nothing
+void MB4Driver::setFastAccess(bool enable){
+   this->fastAccess = enable;
+}
+
+// setSPIClock: sets the clock used for all SPI communication with the MB4
+// Parameters:
+// clock: the SPI clock in Hz. The SPI hardware uses the fastest clock it can
+//        that is not faster than this.
+// returns: nothing
+void MB4Driver::setSPIClock(uint32_t clock){
+   this->spiClock = clock;
+   this->spiSettings = SPISettings(clock, MSBFIRST, SPI_MODE0);
+}
+
+// setMAClock: sets the MA clock the encoders are read with. If the cycles 
+//             then no longer fit in the cycle period, the period is 
+//             lengthened to the new getCycleTime(). Until the MB4 has 
+//             started this only takes effect once it does.
+// Parameters:
+// clock: the MA clock in Hz. The MB4 uses the fastest clock it can that is no
+//        faster than this.
+// returns: the MA clock achieved in Hz
+uint32_t MB4Driver::setMAClock(uint32_t clock){
+   uint32_t divider = (clock == 0) ? 0 : (MB4_CLOCK + 2*clock - 1) / (2*clock);
+   divider = (divider < 1) ? 1 : divider;
+   this->freqS = (divider > 32) ? 31 : divider - 1;
+
+   if (this->isReady()){
+      this->writeFields(MB4Fields::FreqS::set(this->freqS));
+   }
+   if (this->getCyclePeriod() < this->getCycleTime()){
+      this->setCyclePeriod(this->getCycleTime());
+   }
+   return this->getMAClock();
+}
+
+// getMAClock: gets the MA clock the encoders are read with
+// Parameters: None
+// returns: the MA clock in Hz
+uint32_t MB4Driver::getMAClock(){
+   return MB4_CLOCK / (2 * (this->freqS + 1));
+}
+
+// getCycleTime: works out how long each cycle takes on the line at the MA
+//               clock in use, which is the shortest the cycle period can be
+// Parameters: None
+// returns: the time in microseconds, rounded up
+uint32_t MB4Driver::getCycleTime(){
+   uint32_t bits = this->getSlaveCount() * FRAME_SLAVE_BITS + FRAME_OVERHEAD_BITS;
+   uint32_t clock = this->getMAClock();
+   return (bits * 1000000UL + clock - 1) / clock + ENCODER_TIMEOUT;
+}
+
+// setCyclePeriod: sets the time between the starts of the automatic read 
+//                 cycles. Periods up to AGS_MAX_STEPS fine steps are set in
+//                 fine steps, longer ones are rounded up to coarse steps. An
+//                 observer given samples by readSample() is told the new 
+//                 period. Until the MB4 has started this only takes effect 
+//                 once it does.
+// Parameters:
+// periodMicros: the period wanted in microseconds
+// returns: the period achieved in microseconds, which is never shorter than 
+//          the period wanted or getCycleTime(), unless it is longer than 
+//          AGS_MAX_STEPS coarse steps
+uint32_t MB4Driver::setCyclePeriod(uint32_t periodMicros){
+   uint32_t cycleTime = this->getCycleTime();
+   if (periodMicros < cycleTime){
+      periodMicros = cycleTime;
+   }
+
+   uint8_t coarse = (periodMicros > AGS_MAX_STEPS * AGS_FINE_STEP) ? AGS_COARSE : 0;
+   uint32_t step = coarse ? AGS_COARSE_STEP : AGS_FINE_STEP;
+   uint32_t steps = (periodMicros + step - 1) / step;
+   steps = (steps < 1) ? 1 : ((steps > AGS_MAX_STEPS) ? AGS_MAX_STEPS : steps);
+   this->freqAgs = coarse | (steps - 1);
+
+   if (this->isReady()){
+      this->writeFields(MB4Fields::FreqAgs::set(this->freqAgs));
+   }
+
+   uint32_t achieved = this->getCyclePeriod();
+   if (this->observer != 0){
+      this->observer->setPeriod(achieved);
+   }
+   return achieved;
+}
+
+// getCyclePeriod: gets the time between the starts of the automatic read 
+//                 cycles, exactly as set in FREQAGS
+// Parameters: None
+// returns: the period in microseconds
+uint32_t MB4Driver::getCyclePeriod(){
+   uint32_t step = (this->freqAgs & AGS_COARSE) ? AGS_COARSE_STEP : AGS_FINE_STEP;
+   return ((this->freqAgs & ~AGS_COARSE) + 1) * step;
+}
+
+// setAdaptiveRate: has the cycle period follow how fast the encoder is 
+//                  moving, as tracked by the observer given to 
+//                  setObserver(). The encoders are read at the fast period 
+//                  while moving at least fastVelocity, and at the slow period
+//                  once they have slowed to under fastVelocity / 
+//                  ADAPTIVE_HYSTERESIS, which frees up the bus and the 
+//                  encoders while nothing is moving. The velocity is checked 
+//                  every ADAPTIVE_INTERVAL from readSample().
+// Parameters:
+// fastPeriod: the period while moving in microseconds, or 0 to stop adapting
+//             and stay at the period in use
+// slowPeriod: the period while still in microseconds
+// fastVelocity: the velocity to speed up at in position units per second
+// returns: nothing
+void MB4Driver::setAdaptiveRate(uint32_t fastPeriod, uint32_t slowPeriod, 
+                                position_t fastVelocity){
+   this->adaptiveFastPeriod = fastPeriod;
+   this->adaptiveSlowPeriod = slowPeriod;
+   this->adaptiveVelocity = fastVelocity;
+
+   // Start out fast, so that nothing is missed until the velocity is known
+   if (fastPeriod != 0){
+      this->adaptiveFast = true;
+      this->adaptiveChecked = millis();
+      this->setCyclePeriod(fastPeriod);
+   }
+}
+
+// adaptRate: switches between the fast and slow cycle periods of the 
+//            adaptive rate, going by the velocity of the observer
+// Parameters: None
+// returns: nothing
+void MB4Driver::adaptRate(){
+   if (this->adaptiveFastPeriod == 0 || this->observer == 0 || 
+       millis() - this->adaptiveChecked < ADAPTIVE_INTERVAL){
+      return;
+   }
+   this->adaptiveChecked = millis();
+
+   if (!this->observer->isTracking()){
+      return;
+   }
+
+   position_t velocity = this->convertCountsFixed(this->observer->getState().velocity);
+   velocity = (velocity < 0) ? -velocity : velocity;
+
+   if (!this->adaptiveFast && velocity >= this->adaptiveVelocity){
+      this->adaptiveFast = true;
+      this->setCyclePeriod(this->adaptiveFastPeriod);
+   }
+   else if (this->adaptiveFast && 
+            velocity < this->adaptiveVelocity / ADAPTIVE_HYSTERESIS){
+      this->adaptiveFast = false;
+      this->setCyclePeriod(this->adaptiveSlowPeriod);
+   }
+}
+
+// getSPIClock: gets the clock used for SPI communication with the MB4
+// Parameters: None
+// returns: the SPI clock in Hz
+uint32_t MB4Driver::getSPIClock(){
+   return this->spiClock;
+}
+
+// checkSPIClock: checks that communication with the MB4 is reliable at the 
+//                current SPI clock. VERSION and REVISION are read back and 
+//                compared to known good values, and test patterns are 
+//                written to and read back from the scratch register.
+// Parameters:
+// version: the value of VERSION read at a known good clock
+// revision: the value of REVISION read at a known good clock
+// useScratch: whether the scratch register is free to be written
+// returns: true if every check passed SPI_CALIBRATION_TRIALS times
+bool MB4Driver::checkSPIClock(uint8_t version, uint8_t revision, bool useScratch){
+   for(uint8_t trial = 0; trial < SPI_CALIBRATION_TRIALS; trial++){
+      if (this->readRegister(VERSION, 1) != version || 
+          this->readRegister(REVISION, 1) != revision) {
+         return false;
+      }
+
+      if (useScratch) {
+         // Alternate between patterns so that every bit has to toggle
+         uint8_t pattern = (trial & 1) ? 0xAA : 0x55;
+         this->writeRegister(SCRATCH_REG, pattern);
+         if (this->readRegister(SCRATCH_REG, 1) != pattern) {
+            return false;
+         }
+      }
+   }
+   return true;
+}
+
+// calibrateSPIClock: finds the fastest SPI clock that communication with the 
+//                    MB4 is reliable at. Starting from the current clock, 
+//                    which must be known to work, the clock is doubled until
+//                    a check fails or maxClock is reached, and the last clock
+//                    that passed is kept. This should not be used while 
+//                    interrupt acquisition is running.
+// Parameters:
+// maxClock: (optional parameter) the fastest clock to try in Hz
+// returns: the SPI clock in Hz that was settled on
+uint32_t MB4Driver::calibrateSPIClock(uint32_t maxClock){
+   uint32_t goodClock = this->spiClock;
+
+   // Read the known register values at the clock that is known to work
+   uint8_t version = this->readRegister(VERSION, 1);
+   uint8_t revision = this->readRegister(REVISION, 1);
+
+   // The scratch register is only free if the last slave isn't used
+   bool useScratch = this->getSlaveCount() < MAX_SLAVES;
+   uint8_t scratch = 0;
+   if (useScratch) {
+      scratch = this->readRegister(SCRATCH_REG, 1);
+   }
+
+   while (goodClock * 2 <= maxClock) {
+      this->setSPIClock(goodClock * 2);
+      if (!this->checkSPIClock(version, revision, useScratch)) {
+         break;
+      }
+      goodClock *= 2;
+   }
+
+   // Go back to the fastest clock that passed, and put back the scratch 
+   // register as it was
+   this->setSPIClock(goodClock);
+   if (useScratch) {
+      this->writeRegister(SCRATCH_REG, scratch);
+   }
+
+   return goodClock;
+}
+
+// setSoftwareCRC: chooses how the CRC of each frame is checked. By default
+//                 the SVALID register is read after the frame, which costs an
+//                 extra transaction per read. With the software check the CRC
+//                 received in the frame is checked here instead.
+// Parameters:
+// enable: true to check the CRC in software, false to read SVALID
+// returns: nothing
+void MB4Driver::setSoftwareCRC(bool enable){
+   this->softwareCRC = enable;
+}
+
+// checkFrameCRC: checks the CRC received in a frame against the CRC of the 
+//                frame's data bits. BiSS sends the CRC inverted.
+// Parameters:
+// frame: the frame to check
+// returns: true if the CRC is correct
+bool MB4Driver::checkFrameCRC(const PositionFrame& frame){
+   uint32_t frameData = ((frame.rawPosition << 2) | frame.encoderStatus) & 
+                        ((1UL << BISS_CRC6_DATA_BITS) - 1);
+   return bissCRC6(frameData) == (~frame.crc & 0b00111111);
+}
+
+// checkFrameCRCs: checks the CRC of a whole block of frames, such as all of 
+//                 the slaves read by readPositionFrames(). The svalid of each
+//                 frame is set the way the MB4 would set it: 2 if the CRC is 
+//                 correct, 0 if not.
+// Parameters:
+// frames: the array of frames to check
+// numFrames: the number of frames in the array
+// returns: the number of frames with an incorrect CRC
+uint8_t MB4Driver::checkFrameCRCs(PositionFrame* frames, uint8_t numFrames){
+   uint8_t errors = 0;
+   for(uint8_t index = 0; index < numFrames; index++){
+      if (this->checkFrameCRC(frames[index])) {
+         frames[index].svalid = 2;
+      }
+      else {
+         frames[index].svalid = 0;
+         errors++;
+      }
+   }
+   return errors;
+}
+
+// isShadowed: checks if a register is one that the driver keeps a shadow
+//             copy of. The status registers are never shadowed since the MB4
+//             changes them on its own.
+// Parameters:
+// registerAddress: the address of the register to check
+// returns: true if the register is shadowed
+bool MB4Driver::isShadowed(uint8_t registerAddress){
+   return (registerAddress >= SHADOW_START) && (registerAddress <= SHADOW_END) 
+      && !((registerAddress >= STATUS_REG) && (registerAddress <= CDMTIMEOUT));
+}
+
+// updateShadow: stores a value known to be in a register of the MB4 in the 
+//               shadow copy, marking that copy as valid. Registers that are 
+//               not shadowed are ignored.
+// Parameters:
+// registerAddress: the address of the register
+// data: the value that the register holds
+// returns: nothing
+void MB4Driver::updateShadow(uint8_t registerAddress, uint8_t data){
+   if (this->isShadowed(registerAddress)){
+      uint8_t index = registerAddress - SHADOW_START;
+      this->shadowRegisters[index] = data;
+      this->shadowValid[index >> 3] |= (1 << (index & 7));
+   }
+}
+
+// readCachedRegister: reads a single register, using the shadow copy if it is
+//                     valid so that no SPI transaction is needed. Otherwise 
+//                     the register is read from the MB4 and the shadow copy 
+//                     is filled in.
+// Parameters:
+// registerAddress: the address of the register to read
+// returns: the value of the register
+uint8_t MB4Driver::readCachedRegister(uint8_t registerAddress){
+   if (this->isShadowed(registerAddress)){
+      uint8_t index = registerAddress - SHADOW_START;
+      if (this->shadowValid[index >> 3] & (1 << (index & 7))){
+         return this->shadowRegisters[index];
+      }
+   }
+
+   // readRegister takes care of filling in the shadow copy
+   return this->readRegister(registerAddress, 1);
+}
+
+// modifyRegister: changes only some of the bits of a register. With a valid 
+//                 shadow copy this is a single write instead of a 
+//                 read-modify-write over SPI.
+// Parameters:
+// registerAddress: the address of the register to modify
+// mask: the bits of the register to change
+// value: the new value of the bits in mask
+// returns: nothing
+void MB4Driver::modifyRegister(uint8_t registerAddress, uint8_t mask, uint8_t value){
+   uint8_t current = this->readCachedRegister(registerAddress);
+   current &= ~mask;
+   current |= (value & mask);
+
+   // The instruction register has its own SPI command
+   if (registerAddress == INSTR){
+      this->writeInstruction(current);
+   }
+   else {
+      this->writeRegister(registerAddress, current);
+   }
+}
+
+// invalidateRegister: marks the shadow copy of a register as unknown, so that 
+//                     it will be read from the MB4 the next time it is needed.
+//                     Use this after something other than this driver could 
+//                     have changed the register.
+// Parameters:
+// registerAddress: the address of the register to invalidate
+// returns: nothing
+void MB4Driver::invalidateRegister(uint8_t registerAddress){
+   if (this->isShadowed(registerAddress)){
+      uint8_t index = registerAddress - SHADOW_START;
+      this->shadowValid[index >> 3] &= ~(1 << (index & 7));
+   }
+}
+
+// invalidateShadow: marks the shadow copy of every register as unknown
+// Parameters: None
+// returns: nothing
+void MB4Driver::invalidateShadow(){
+   memset(this->shadowValid, 0, sizeof(this->shadowValid));
+}
+
+// resync: refills the whole shadow copy from the MB4. The status registers 
+//         in the middle of the shadowed range are skipped, so this takes two
+//         block reads.
+// Parameters: None
+// returns: nothing
+void MB4Driver::resync(){
+   // readRegister marks each of the registers read as valid
+   this->readRegister(SHADOW_START, this->shadowRegisters, 
+                      STATUS_REG - SHADOW_START);
+   this->readRegister(INSTR, this->shadowRegisters + (INSTR - SHADOW_START), 
+                      SHADOW_END - INSTR + 1);
+}
+
+// snapshotRegisters: copies the current configuration of the MB4 out of the 
+//                    shadow copy. Only registers that are not valid in the 
+//                    shadow copy are read over SPI. 
+// Parameters:
+// image: an array of SHADOW_SIZE bytes starting at SHADOW_START to copy into.
+//        The status registers that are not shadowed are given as 0.
+// returns: nothing
+void MB4Driver::snapshotRegisters(uint8_t* image){
+   for(uint8_t index = 0; index < SHADOW_SIZE; index++){
+      uint8_t registerAddress = SHADOW_START + index;
+      image[index] = (this->isShadowed(registerAddress)) ? 
+                     this->readCachedRegister(registerAddress) : 0;
+   }
+}
 
-   SPI.endTransaction();
+// lockBank: locks the sensor data banks so that the MB4 does not update them
+//           while they are being read. INSTR comes from the shadow copy, so 
+//           this is a single SPI transaction.
+// Parameters: None
+// returns: nothing
+void MB4Driver::lockBank(){
+   this->writeInstruction(this->readCachedRegister(INSTR) | HOLDBANK);
+}
 
+// unlockBank: unlocks the sensor data banks so that the MB4 can update them
+// Parameters: None
+// returns: nothing
+void MB4Driver::unlockBank(){
+   this->writeInstruction(this->readCachedRegister(INSTR) & ~HOLDBANK);
+}
+
+// readFrames: reads complete frames for the first numSlaves slaves from the 
+//             MB4. Their SCDATA banks are contiguous, so they are all read in a
+//             single burst followed by STATUS_REG and SVALID in a second burst, 
+//             all while the banks are locked so that no frame can be updated 
+//             part way through. INSTR comes from the shadow copy, so locking 
+//             and unlocking only take a single transaction each.
+// Parameters:
+// frames: an array of at least numSlaves frames to read into
+// numSlaves: the number of slaves to read, starting with the first
+// Returns: nothing (the frames are placed into frames)
+void MB4Driver::readFrames(PositionFrame* frames, uint8_t numSlaves) {
+   uint32_t startTime = micros();
+
+   // Lock the banks before reading them to prevent data corruption
+   this->lockBank();
+
+   // Read all of the SCDATA banks in one transaction 
+   uint8_t banks[MAX_SLAVES * SCDATA_SIZE];
+   if (this->fastAccess){
+      this->fastReadRegister(banks, numSlaves * SCDATA_SIZE);
+   }
+   else {
+      this->readRegister(SCDATA1, banks, numSlaves * SCDATA_SIZE);
+   }
+
+   // Read whether the CRC of each frame was correct, 4 slaves per register,
+   // unless the CRC is going to be checked here. STATUS_REG sits just before
+   // SVALID, so it comes along in the same transaction.
+   uint8_t status[1 + (MAX_SLAVES + 3) / 4];
+   uint8_t* svalid = status + (SVALID - STATUS_REG);
+   if (!this->softwareCRC){
+      this->readRegister(STATUS_REG, status, 1 + (numSlaves + 3) / 4);
+   }
+
+   // Unlock the banks after reading them to allow those registers to update
+   this->unlockBank();
+
+   for(uint8_t slave = 0; slave < numSlaves; slave++){
+      uint8_t* bank = banks + slave*SCDATA_SIZE;
+      PositionFrame& frame = frames[slave];
+
+      // Unpack the position, the first register is the least significant byte
+      uint32_t reading = 0;
+      for(uint8_t index = 0; index < 4; index++){
+         reading |= (uint32_t)(bank[index]) << (index*8);
+      }
+
+      // The encoder status (no warnings is 00, refer to LMA10 datasheet) 
+      // occupies the lowest two bits of the frame
+      frame.encoderStatus = bank[0] & 0b00000011;
+
+      // Shift the status bits out of the reading
+      frame.rawPosition = reading >> 2;
+
+      frame.crc = bank[SCDATA_CRC_OFFSET];
+
+      if (!this->softwareCRC){
+         frame.svalid = (svalid[slave / 4] >> ((slave % 4) * 2)) & 0b00000011;
+      }
+   }
+
+   if (this->softwareCRC){
+      this->checkFrameCRCs(frames, numSlaves);
+   }
+
+   uint32_t readTime = micros() - startTime;
+
+   // Record the read. Frames are also read by the end of transmission 
+   // interrupt, so interrupts are held off while the records are updated.
+   uint8_t oldSREG = SREG;
+   cli();
+   if (!this->softwareCRC){
+      this->recordMB4Status(status[0]);
+
+      // EOT is cleared by reading STATUS_REG, so without it no new cycle has
+      // finished since the last read
+      if (!(status[0] & STATUS_EOT) && !this->cycleEnded) {
+         countUp(this->telemetry.staleFrames);
+      }
+   }
+   this->cycleEnded = false;
+   this->telemetry.samples++;
+   this->recordLatency(readTime);
+   SREG = oldSREG;
+}
+
+// checkCycleEnd: checks whether the MB4 has finished a cycle since STATUS_REG
+//                was last read, for waiting on a cycle started with INIT. 
+//                STATUS_REG is recorded the same way as when frames are read.
+// Parameters: None
+// Returns: true if EOT was set
+bool MB4Driver::checkCycleEnd() {
+   uint8_t mb4Status = this->readRegister(STATUS_REG, 1);
+
+   uint8_t oldSREG = SREG;
+   cli();
+   this->recordMB4Status(mb4Status);
+   SREG = oldSREG;
+
+   if (mb4Status & STATUS_EOT) {
+      this->cycleEnded = true;
+   }
+   return this->cycleEnded;
+}
+
+// readPositionFrame:
+// A function to read one complete frame of the first slave from the MB4. The
+// whole SCDATA1 bank (SCDATA1 through SCDATA1_CRC) is read in a single burst
+// followed by SVALID. 
+// Parameters: none
+// Returns: a PositionFrame holding the position, status bits, CRC and SVALID
+MB4Driver::PositionFrame MB4Driver::readPositionFrame() {
+   PositionFrame frame;
+   this->readFrames(&frame, 1);
+   return frame;
+}
+
+// readPositionFrames:
+// A function to read one complete frame of every slave on both channels from 
+// the MB4, all in the same number of transactions as a single slave. 
+// Parameters:
+// frames: an array of at least getSlaveCount() frames to read into. The 
+//         slaves of Channel 1 come first, followed by those of Channel 2.
+// Returns: nothing (the frames are placed into frames)
+void MB4Driver::readPositionFrames(PositionFrame* frames) {
+   this->readFrames(frames, this->getSlaveCount());
+}
+
+// getSlaveCount: gets the total number of slaves on both channels
+// Parameters: none
+// Returns: the number of slaves, and so frames read by readPositionFrames()
+uint8_t MB4Driver::getSlaveCount() {
+   return this->channel1Slaves + this->channel2Slaves;
 }
 
 // getRawPosition:
 // A function to get the raw position data from the MB4 chip. This is
-// where SPI must be used to communicate with the MB4 chip. 
+// where SPI must be used to communicate with the MB4 chip. While this driver
+// is acquiring on the end of transmission interrupt nothing is read, since 
+// the interrupt could unlock the bank part way through the read, and the 
+// position last collected by readSample() is returned instead.
 // Parameters: none
 // Returns: raw position in a 0 to 2^26 number. 
 uint32_t MB4Driver::getRawPosition() {
+   if (acquiringDriver == this) {
+      return this->currentRawPosition;
+   }
 
-   // Lock the bank before reading SCDATA1 to prevent data corruption
-   uint8_t currentInstruction = this->readRegister(INSTR, 1);
-   currentInstruction |= (1 << 6);
-   this->writeInstruction(currentInstruction);
+   MB4_TRACE_CALL_BEGIN();
 
-   // // Check out how the instruction register responds
-   // Serial.print("INSTR after lock: \t ");
-   // Serial.println(this->readRegister(INSTR, 1), BIN);
+   // Read a complete frame from the MB4 in as few transactions as possible
+   PositionFrame frame = this->readPositionFrame();
 
-   // Create an array of 4 x 8 bit numbers
-   uint32_t readingBuffer;
+   // Check if the reading is valid, only updating the position if so
+   if (this->checkStatus(frame.encoderStatus, frame.svalid == 2) == no_errors){
+      this->currentRawPosition = frame.rawPosition;
 
-   // Initialize a zero reading
-   uint32_t reading = 0;
+      // // Print out the raw encoder reading recieved
+      // Serial.print("Raw Encoder Reading: \t");
+      // Serial.println(frame.rawPosition);
+   }
 
-   // Read the data and unpack into correct order one register at a time
-   for(uint8_t index = 0; index < 4; index++){
-      readingBuffer = this->readRegister(SCDATA1 + index, 1);
-      reading += readingBuffer << (index*8);
+   MB4_TRACE_CALL_END();
+   return this->currentRawPosition;
+
+}
+
+// beginInterruptAcquisition: starts capturing a sample every time the MB4 
+//                            signals the end of an AGS cycle, instead of 
+//                            waiting for getRawPosition() to be polled. The
+//                            MB4's interrupt output must be wired to a pin 
+//                            that supports external interrupts (D2 or D3 on
+//                            an Uno or Nano). Each sample is timestamped and
+//                            placed into buffer, to be collected with 
+//                            readSample() or directly from the buffer.
+// Parameters:
+// interruptPin: the pin connected to the interrupt output of the MB4
+// buffer: the buffer to place captured samples into
+// edge: (optional parameter) the edge that marks the end of a cycle
+// returns: true if acquisition started, false if the pin has no interrupt or
+//          another driver is already acquiring
+bool MB4Driver::beginInterruptAcquisition(uint8_t interruptPin, SampleBuffer* buffer,
+                                          uint8_t edge){
+   int8_t interruptNumber = digitalPinToInterrupt(interruptPin);
+   if (interruptNumber == NOT_AN_INTERRUPT || 
+      (acquiringDriver != 0 && acquiringDriver != this)) {
+      return false;
    }
 
-   // Shift the status bits out of the reading
-   reading = reading >> 2;
+   // Restarting on another pin must release the old interrupt first
+   this->endInterruptAcquisition();
 
-   // Check if the reading is valid 
-   // Can use unprotected checkStatus_unprotected() since data registers are 
-   // locked.
-   if (this->checkStatus_unprotected() == no_errors){
-      this->currentRawPosition = reading;
+   this->acquisitionBuffer = buffer;
+   this->acquisitionInterrupt = interruptNumber;
+   acquiringDriver = this;
 
-      // // Print out the raw encoder reading recieved
-      // Serial.print("Raw Encoder Reading: \t");
-      // Serial.println(reading);
+   // Have every SPI transaction outside of the interrupt hold off the 
+   // interrupt, so that a capture never lands in the middle of another 
+   // transaction with the MB4
+   SPI.usingInterrupt(interruptNumber);
+
+   pinMode(interruptPin, INPUT_PULLUP);
+   attachInterrupt(interruptNumber, MB4Driver::endOfTransmissionISR, edge);
+
+   return true;
+}
+
+// endInterruptAcquisition: stops capturing samples on the end of transmission
+//                          interrupt. getRawPosition() can still be polled.
+// Parameters: None
+// returns: nothing
+void MB4Driver::endInterruptAcquisition(){
+   if (acquiringDriver == this){
+      detachInterrupt(this->acquisitionInterrupt);
+
+      // Stop holding off the interrupt during every SPI transaction
+      SPI.notUsingInterrupt(this->acquisitionInterrupt);
+      acquiringDriver = 0;
+      this->acquisitionInterrupt = NOT_AN_INTERRUPT;
    }
+}
 
-   // Unlock the bank after reading SCDATA1 to allow those registers to update
-   currentInstruction = this->readRegister(INSTR, 1);
-   currentInstruction &= ~(1 << 6);
-   this->writeInstruction(currentInstruction);
+// endOfTransmissionISR: interrupt service routine for the end of an AGS 
+//                       cycle. The frame is read right away, before the next
+//                       cycle can replace it, and queued in the acquisition 
+//                       buffer. No status checking is done here since that 
+//                       can print over Serial.
+// Parameters: None
+// returns: nothing
+void MB4Driver::endOfTransmissionISR(){
+   MB4Driver* driver = acquiringDriver;
+   if (driver == 0) {
+      return;
+   }
 
-   // // Check out how the instruction register responds
-   // Serial.print("INSTR after unlock: \t ");
-   // Serial.println(this->readRegister(INSTR, 1), BIN);
+   uint32_t timestamp = micros();
+   PositionFrame frame = driver->readPositionFrame();
 
-   return this->currentRawPosition;
+   uint8_t status = frame.encoderStatus;
+   if (frame.svalid != 2) {
+      status |= SAMPLE_INVALID_CRC;
+   }
+
+   // A full buffer counts the overrun itself
+   driver->acquisitionBuffer->push(timestamp, frame.rawPosition, status);
+}
+
+// readSample: collects the oldest sample captured by the end of transmission
+//             interrupt. The status of the sample is checked here, and the raw 
+//             position is updated if the sample is valid.
+// Parameters:
+// sample: the sample to copy the captured sample into
+// returns: true if a sample was copied, false if there was none
+bool MB4Driver::readSample(Sample& sample){
+   if (this->acquisitionBuffer == 0 || !this->acquisitionBuffer->pop(sample)) {
+      return false;
+   }
+
+   bool valid = !(sample.status & SAMPLE_INVALID_CRC);
+   if (this->checkStatus(sample.status & 0b00000011, valid) == no_errors){
+      this->currentRawPosition = sample.rawPosition;
+
+      if (this->observer != 0) {
+         this->observer->update(sample.timestamp, sample.rawPosition);
+      }
+      if (this->decimator != 0) {
+         this->decimator->update(sample.timestamp, sample.rawPosition);
+      }
+
+      this->adaptRate();
+   }
+
+   return true;
+}
+
+// captureBurst: captures numSamples consecutive samples into burst as fast as
+//               the MB4 and SPI allow, for looking at the motion like a scope
+//               would. STATUS_REG is polled for the end of each cycle, so the
+//               interrupt output is not needed and no cycle is read twice, 
+//               so no frame is ever stale. The whole burst shares one 
+//               SPI.beginTransaction(), with only the chip select changing 
+//               between accesses, and nothing is printed or converted until
+//               it is finished, so the loop only moves bytes. Every 
+//               STATUS_REG read and frame read is recorded the same way as 
+//               outside a burst. The MB4 should already be running at the 
+//               rate wanted (see setCyclePeriod()). Samples are not given to
+//               the observer or decimator, but the status of each is checked
+//               afterwards and the raw position is left at the last valid one.
+// Parameters:
+// burst: the buffer to capture into. Its count is set to the number captured.
+// numSamples: the number of samples to capture, at most burst.capacity
+// returns: the number of samples captured, which is less than numSamples if 
+//          no cycle ended within BURST_TIMEOUT, or 0 if this driver is 
+//          acquiring samples on the end of transmission interrupt
+uint16_t MB4Driver::captureBurst(BurstBuffer& burst, uint16_t numSamples){
+   burst.count = 0;
+   if (acquiringDriver == this) {
+      return 0;
+   }
+   if (numSamples > burst.capacity) {
+      numSamples = burst.capacity;
+   }
+
+   // The CRC byte is only needed if it is going to be checked here
+   uint8_t bankBytes = this->softwareCRC ? SCDATA_CRC_OFFSET + 1 : 4;
+   uint8_t bank[SCDATA_SIZE];
+   uint16_t count = 0;
+
+   // Share one SPI.beginTransaction() over the whole burst, the same way 
+   // MB4Bus does for a round of reads
+   bool wasOpen = batchOpen;
+   if (!wasOpen) {
+      SPI.beginTransaction(this->spiSettings);
+      batchOpen = true;
+   }
+
+   uint32_t waitStart = millis();
+   while (count < numSamples) {
+      // Reading STATUS_REG clears EOT, so each cycle is only seen once. The
+      // other latched bits are kept by recordMB4Status(), including the end
+      // of any register communication going on alongside.
+      uint8_t mb4Status = this->readRegister(STATUS_REG, 1);
+      uint8_t oldSREG = SREG;
+      cli();
+      this->recordMB4Status(mb4Status);
+      SREG = oldSREG;
+      if (!(mb4Status & STATUS_EOT)) {
+         if (millis() - waitStart >= BURST_TIMEOUT) {
+            break;
+         }
+         continue;
+      }
+      uint32_t timestamp = micros();
+
+      this->lockBank();
+      if (this->fastAccess){
+         this->fastReadRegister(bank, bankBytes);
+      }
+      else {
+         this->readRegister(SCDATA1, bank, bankBytes);
+      }
+      uint8_t svalid = this->softwareCRC ? 0 : this->readRegister(SVALID, 1);
+      this->unlockBank();
+      uint32_t readTime = micros() - timestamp;
+
+      // The first register is the least significant byte, and the encoder 
+      // status occupies the lowest two bits
+      uint32_t reading = (uint32_t)bank[0] | ((uint32_t)bank[1] << 8) |
+                         ((uint32_t)bank[2] << 16) | ((uint32_t)bank[3] << 24);
+      uint8_t status = bank[0] & 0b00000011;
+
+      bool valid;
+      if (this->softwareCRC){
+         valid = bissCRC6(reading & ((1UL << BISS_CRC6_DATA_BITS) - 1)) == 
+                 (~bank[SCDATA_CRC_OFFSET] & 0b00111111);
+      }
+      else {
+         valid = (svalid & 0b00000011) == 2;
+      }
+      if (!valid) {
+         status |= SAMPLE_INVALID_CRC;
+      }
+
+      burst.timestamps[count] = timestamp;
+      burst.positions[count] = reading >> 2;
+      burst.status[count] = status;
+      count++;
+
+      oldSREG = SREG;
+      cli();
+      this->telemetry.samples++;
+      this->recordLatency(readTime);
+      SREG = oldSREG;
+
+      waitStart = millis();
+   }
+
+   if (!wasOpen) {
+      batchOpen = false;
+      SPI.endTransaction();
+   }
+   burst.count = count;
+
+   // The EOT of the last cycle was used up here, so the next frame read 
+   // outside the burst waits for a cycle of its own
+   this->cycleEnded = false;
+
+   for(uint16_t index = 0; index < count; index++){
+      bool valid = !(burst.status[index] & SAMPLE_INVALID_CRC);
+      if (this->checkStatus(burst.status[index] & 0b00000011, valid) == no_errors){
+         this->currentRawPosition = burst.positions[index];
+      }
+   }
 
+   return count;
+}
+
+// dumpBurst: writes the samples of a burst in the compact binary form 
+//            described with BURST_MAGIC in sample-buffer.h, six bytes per 
+//            sample. Each record is written as it is packed, so no second 
+//            buffer is needed.
+// Parameters:
+// burst: the burst to write, as filled by captureBurst()
+// out: (optional parameter) where to write it, Serial if not given
+// returns: nothing
+void MB4Driver::dumpBurst(const BurstBuffer& burst, Print& out){
+   uint8_t header[BURST_HEADER_SIZE];
+   uint32_t firstTimestamp = burst.count > 0 ? burst.timestamps[0] : 0;
+
+   memcpy(header, BURST_MAGIC, BURST_MAGIC_SIZE);
+   header[BURST_MAGIC_SIZE] = BURST_VERSION;
+   header[BURST_MAGIC_SIZE + 1] = burst.count;
+   header[BURST_MAGIC_SIZE + 2] = burst.count >> 8;
+   for(uint8_t index = 0; index < 4; index++){
+      header[BURST_MAGIC_SIZE + 3 + index] = firstTimestamp >> (index*8);
+   }
+   out.write(header, BURST_HEADER_SIZE);
+
+   uint16_t checksum = 0;
+   for(uint8_t index = BURST_MAGIC_SIZE; index < BURST_HEADER_SIZE; index++){
+      checksum += header[index];
+   }
+
+   uint32_t lastTimestamp = firstTimestamp;
+   for(uint16_t sample = 0; sample < burst.count; sample++){
+      uint32_t delta = burst.timestamps[sample] - lastTimestamp;
+      if (delta > BURST_MAX_DELTA) {
+         delta = BURST_MAX_DELTA;
+      }
+      lastTimestamp = burst.timestamps[sample];
+
+      uint32_t packed = (burst.positions[sample] & BURST_POSITION_MASK) |
+                        ((uint32_t)(burst.status[sample] & 0b00000011) << BURST_STATUS_SHIFT);
+      if (burst.status[sample] & SAMPLE_INVALID_CRC) {
+         packed |= BURST_INVALID_CRC;
+      }
+
+      uint8_t record[BURST_RECORD_SIZE];
+      record[0] = delta;
+      record[1] = delta >> 8;
+      for(uint8_t index = 0; index < 4; index++){
+         record[2 + index] = packed >> (index*8);
+      }
+      out.write(record, BURST_RECORD_SIZE);
+
+      for(uint8_t index = 0; index < BURST_RECORD_SIZE; index++){
+         checksum += record[index];
+      }
+   }
+
+   uint8_t trailer[2] = {(uint8_t)checksum, (uint8_t)(checksum >> 8)};
+   out.write(trailer, 2);
+}
+
+// setObserver: gives an observer every valid sample collected by 
+//              readSample(), so that it tracks the velocity and acceleration
+//              of the encoder at the full sample rate. Samples from polling
+//              getRawPosition() are not given to it, since they don't arrive
+//              at a steady rate.
+// Parameters:
+// observer: the observer, or 0 to stop giving samples to one
+// returns: nothing
+void MB4Driver::setObserver(PositionObserver* observer){
+   this->observer = observer;
+}
+
+// setDecimator: gives a decimator every valid sample collected by 
+//               readSample(), so that the MB4 can run at its full rate while
+//               the display and logging get fewer, finer positions. Samples 
+//               from polling getRawPosition() are not given to it.
+// Parameters:
+// decimator: the decimator, or 0 to stop giving samples to one
+// returns: nothing
+void MB4Driver::setDecimator(PositionDecimator* decimator){
+   this->decimator = decimator;
 }
 
-// checkStatus_unprotected: a function for use after the data registers
-//                          have been locked. Checks the error registers
-//                          to make sure the encoder and the MB4 are not
-//                          reporting any errors.
-// Parameters: None 
+// checkStatus: a function for checking the status reported with a reading
+//              from the MB4. Checks the encoder status bits and SVALID to 
+//              make sure the encoder and the MB4 are not reporting any errors.
+//              Nothing is printed here, errors are counted in the telemetry 
+//              instead (see getTelemetry() and printTelemetry()).
+// Parameters: 
+// encoderStatus: the error and warning bits from the encoder (bit 1:0)
+// valid: whether the MB4 reported the CRC of the reading as correct
 // Returns: the currentStatus of the encoder. which can be
 //          no_errors, invalid_crc, encoder_warning, or encoder_alarm.
-uint8_t MB4Driver::checkStatus_unprotected(){
-
-   // The encoder status (no warnings is 00, refer to LMA10 datasheet)
-   uint32_t encoderStatus = this->readRegister(SCDATA1, 1);
+uint8_t MB4Driver::checkStatus(uint8_t encoderStatus, bool valid){
 
-   // Check if CRC is correct
-   bool valid = (this->readRegister(SVALID,1) == 2) ? true : false;
+   this->health.encoderStatus = encoderStatus;
+   this->health.crcValid = valid;
 
    // Check for errors in this order of precedence (some errors trump others)
    if ((encoderStatus == 0) && valid && this->currentStatus != encoder_alarm) {
@@ -396,32 +1536,379 @@ uint8_t MB4Driver::checkStatus_unprotected(){
    else if (!valid && this->currentStatus != encoder_alarm) {               
    // Error in com between MB4 and encoder
       this->currentStatus = invalid_crc;
-      Serial.println("INVALID CRC");
+      countUp(this->telemetry.crcErrors);
    }  
    else if (encoderStatus == 1 && this->currentStatus != encoder_alarm) {  
    // Close to overspeed, consult LMA10 datasheet
       this->currentStatus = encoder_warning; 
-      Serial.println("ENCODER WARNING");
+      countUp(this->telemetry.warnings);
    }
    else if (encoderStatus == 2 || this->currentStatus == encoder_alarm) {   
    // Encoder invalid position data
       this->currentStatus = encoder_alarm;
-      Serial.println("ENCODER ALARM");
+      countUp(this->telemetry.alarms);
    }
 
    return this->currentStatus;
 }
 
+// recordMB4Status: records a value of STATUS_REG in the health record. The 
+//                  MB4 clears the latched bits of STATUS_REG when it is read,
+//                  so the error bits are kept here until clearHealth().
+// Parameters: 
+// mb4Status: the value read from STATUS_REG
+// returns: nothing
+void MB4Driver::recordMB4Status(uint8_t mb4Status){
+   this->health.mb4Status = mb4Status;
+   this->health.mb4Errors |= STATUS_ERRORS(mb4Status);
+   this->transferStatus |= (mb4Status ^ STATUS_LOW_ACTIVE) & (STATUS_REGEND | STATUS_NREGERR);
+}
+
+// getHealth: gets the health of the encoder and the MB4. No transactions are
+//            made, the record is kept up to date by the frames that are 
+//            already being read. STATUS_REG is read along with SVALID, so it
+//            is not updated while the software CRC check is in use.
+// Parameters: None
+// returns: a copy of the health record
+MB4Driver::Health MB4Driver::getHealth(){
+   // The end of transmission interrupt may be updating the record
+   uint8_t oldSREG = SREG;
+   cli();
+   Health health = this->health;
+   SREG = oldSREG;
+
+   health.state = this->currentStatus;
+   return health;
+}
+
+// refreshHealth: reads STATUS_REG, CDMTIMEOUT and the CDS status registers 
+//                into the health record. These are all read in a single 
+//                transaction, so this is suited to being called now and 
+//                then rather than with every frame.
+// Parameters: None
+// returns: a copy of the refreshed health record
+MB4Driver::Health MB4Driver::refreshHealth(){
+   uint8_t registers[CDS_STATUS1 - STATUS_REG + 1];
+   this->readRegister(STATUS_REG, registers, sizeof(registers));
+
+   uint8_t oldSREG = SREG;
+   cli();
+   this->recordMB4Status(registers[0]);
+   this->health.cdmTimeout = registers[CDMTIMEOUT - STATUS_REG];
+   this->health.cdsStatus0 = registers[CDS_STATUS0 - STATUS_REG];
+   this->health.cdsStatus1 = registers[CDS_STATUS1 - STATUS_REG];
+   SREG = oldSREG;
+
+   return this->getHealth();
+}
+
+// clearHealth: clears the latched MB4 errors of the health record. An 
+//              encoder alarm is also cleared, so that the next valid frame is 
+//              accepted again.
+// Parameters: None
+// returns: nothing
+void MB4Driver::clearHealth(){
+   uint8_t oldSREG = SREG;
+   cli();
+   this->health.mb4Errors = 0;
+   SREG = oldSREG;
+
+   this->currentStatus = no_errors;
+}
+
+// recordLatency: adds the time a read took to the read time histogram
+// Parameters: 
+// readTime: the time the read took in microseconds
+// returns: nothing
+void MB4Driver::recordLatency(uint32_t readTime){
+   // Find the highest bit set, stopping at the last bucket
+   uint8_t bucket = 0;
+   while ((readTime >>= 1) != 0 && bucket < LATENCY_BUCKETS - 1) {
+      bucket++;
+   }
+
+   countUp(this->telemetry.latency[bucket]);
+}
+
+// getTelemetry: gets a snapshot of the counts kept since resetTelemetry(). 
+//               This only copies the counts, so it is cheap enough to call 
+//               from loop().
+// Parameters: None
+// returns: a copy of the telemetry
+MB4Driver::Telemetry MB4Driver::getTelemetry(){
+   // The end of transmission interrupt may be updating the counts
+   uint8_t oldSREG = SREG;
+   cli();
+   Telemetry telemetry = this->telemetry;
+   SREG = oldSREG;
+
+   return telemetry;
+}
+
+// resetTelemetry: sets all of the telemetry counts back to zero
+// Parameters: None
+// returns: nothing
+void MB4Driver::resetTelemetry(){
+   uint8_t oldSREG = SREG;
+   cli();
+   memset(&this->telemetry, 0, sizeof(this->telemetry));
+   SREG = oldSREG;
+}
+
+
+// convertCountsFixed: converts a distance or rate in encoder counts (bits)
+//                     into position units using only integer math, the same 
+//                     way as convertRawPositionFixed() but signed and without
+//                     an offset. This is meant for the velocity and 
+//                     acceleration of a PositionObserver.
+// Parameters:
+// counts: the distance in counts, or a rate in counts per second
+// returns: the distance in POSITION_UNITS, or the rate in POSITION_UNITS per 
+//          second
+position_t MB4Driver::convertCountsFixed(int32_t counts){
+   int64_t scaled = (int64_t)(counts) * (uint32_t)(POSITION_SCALE);
+
+   // Round to the nearest unit while dropping the fractional bits
+   scaled += (1LL << (POSITION_SCALE_SHIFT - 1));
+   return (position_t)(scaled >> POSITION_SCALE_SHIFT);
+}
+
+// convertRawPositionFixed: converts the raw position readings of the encoder
+//                          (bits) into position units using only integer 
+//                          math. The raw position is multiplied by a 32 bit 
+//                          fixed point scale into a 64 bit product, which 
+//                          keeps the full resolution of the encoder.
+// Parameters:
+// rawPos: The raw position in bits 
+// offset: The offset distance in position units to acheive 0
+// returns: the position in POSITION_UNITS on the encoder strip
+position_t MB4Driver::convertRawPositionFixed(uint32_t rawPos, position_t offset){
+   return this->convertCountsFixed(rawPos) - offset;
+}
+
+// getPositionFixed: gets the current position of the encoder in position 
+//                   units. This function will automate the call of 
+//                   getRawPosition() and the conversion.
+// Parameters: None
+// returns: the position of the encoder in POSITION_UNITS
+position_t MB4Driver::getPositionFixed(){
+   MB4_TRACE_CALL_BEGIN();
+
+   // Read the current position from the encoder
+   this->getRawPosition();
+
+   position_t position = this->getLastPositionFixed();
+   MB4_TRACE_CALL_END();
+   return position;
+}
+
+// getLastPositionFixed: gets the position of the encoder in position units 
+//                       from the last valid reading, without communicating 
+//                       with the MB4. The calibration (see getCalibration()) 
+//                       is applied to it.
+// Parameters: None
+// returns: the last position of the encoder in POSITION_UNITS
+position_t MB4Driver::getLastPositionFixed(){
+   position_t position = this->convertRawPositionFixed(this->currentRawPosition, 
+                                                       this->offsetFixed);
+   return this->calibration.correct(position);
+}
+
+// convertDecimatedFixed: converts a position given out by a decimator into 
+//                        position units, keeping its fractional counts. The 
+//                        offset and calibration are applied the same way as 
+//                        getLastPositionFixed().
+// Parameters:
+// sample: the decimated sample
+// returns: the position of the sample in POSITION_UNITS
+position_t MB4Driver::convertDecimatedFixed(const DecimatedSample& sample){
+   uint64_t scaled = (uint64_t)(sample.position) * (uint32_t)(POSITION_SCALE);
+
+   // Round to the nearest unit while dropping the fractional bits of both
+   const uint8_t shift = POSITION_SCALE_SHIFT + DECIMATOR_FRACTION_BITS;
+   scaled += (1ULL << (shift - 1));
+   position_t position = (position_t)(scaled >> shift) - this->offsetFixed;
+   return this->calibration.correct(position);
+}
+
+// getCalibration: gets the calibration applied to every position, to load 
+//                 one from EEPROM or PROGMEM, save it, or capture a new one.
+//                 The default corrects for the encoder going off the strip.
+// Parameters: None
+// returns: the calibration table, in position units
+CalibrationTable& MB4Driver::getCalibration(){
+   return this->calibration;
+}
+
+// addCalibrationReference: reads the position now and adds it to the 
+//                          calibration being captured as the measured 
+//                          position at a known reference position. Call
+//                          getCalibration().beginCapture() before the sweep
+//                          and getCalibration().endCapture() after it. 
+//                          The position must be read fresh, so this can't 
+//                          be used while this driver is acquiring on the 
+//                          end of transmission interrupt.
+// Parameters:
+// reference: the known position of the encoder in position units
+// returns: false if the calibration is full or this driver is acquiring on 
+//          the interrupt
+bool MB4Driver::addCalibrationReference(position_t reference){
+   if (acquiringDriver == this) {
+      return false;
+   }
+
+   position_t measured = this->convertRawPositionFixed(this->getRawPosition(), 
+                                                       this->offsetFixed);
+   return this->calibration.addReference(measured, reference);
+}
+
+// requestEncoderRead: starts reading consecutive registers of an encoder 
+//                     with BiSS register communication. The MB4 sends the 
+//                     request one CDM bit per cycle while it carries on 
+//                     reading the position, so this never stalls acquisition.
+//                     Call pollEncoderTransfer() until it is done, then 
+//                     readEncoderData() to collect the registers.
+// Parameters:
+// registerAddress: the first register of the encoder to read
+// count: the number of registers to read, up to REGISTER_DATA_SIZE, which 
+//        are all read by the one request
+// slave: (optional parameter) the slave to read from, starting at 0
+// returns: true if the request was started, false if another one is still 
+//          busy or the request is out of range
+bool MB4Driver::requestEncoderRead(uint8_t registerAddress, uint8_t count, uint8_t slave){
+   return this->startEncoderTransfer(registerAddress, count, slave, false);
+}
+
+// requestEncoderWrite: starts writing consecutive registers of an encoder 
+//                      with BiSS register communication, the same way as 
+//                      requestEncoderRead(). The data is placed into RDATA 
+//                      first, in a single burst.
+// Parameters:
+// registerAddress: the first register of the encoder to write
+// data: an array of the bytes to write
+// count: the number of registers to write, up to REGISTER_DATA_SIZE
+// slave: (optional parameter) the slave to write to, starting at 0
+// returns: true if the request was started, false if another one is still 
+//          busy or the request is out of range
+bool MB4Driver::requestEncoderWrite(uint8_t registerAddress, uint8_t* data, uint8_t count,
+                                    uint8_t slave){
+   if (this->transferState == transfer_busy || count == 0 || count > REGISTER_DATA_SIZE){
+      return false;
+   }
+
+   this->writeRegister(RDATA, data, count);
+   return this->startEncoderTransfer(registerAddress, count, slave, true);
+}
+
+// startEncoderTransfer: sets up SLAVEID, REGADR and REGNUM in a single burst
+//                       and starts the register communication
+// Parameters:
+// registerAddress: the first register of the encoder
+// count: the number of registers
+// slave: the slave, starting at 0
+// write: true to write the registers from RDATA, false to read them into it
+// returns: true if the request was started
+bool MB4Driver::startEncoderTransfer(uint8_t registerAddress, uint8_t count, 
+                                     uint8_t slave, bool write){
+   if (this->transferState == transfer_busy || count == 0 || count > REGISTER_DATA_SIZE ||
+       registerAddress + count > BISS_REGISTERS || slave >= this->getSlaveCount()){
+      return false;
+   }
+
+   uint8_t setup[REGNUM - SLAVEID + 1];
+   setup[SLAVEID - SLAVEID] = (MB4Fields::Cts::set(1) | MB4Fields::SlaveId::set(slave)).bits;
+   setup[REGADR - SLAVEID] = (MB4Fields::Wnr::set(write) | MB4Fields::RegAdr::set(registerAddress)).bits;
+   setup[REGNUM - SLAVEID] = MB4Fields::RegNum::set(count - 1).bits;
+   this->writeRegister(SLAVEID, setup, sizeof(setup));
+
+   this->transferStatus = 0;
+   this->writeInstruction(this->readCachedRegister(INSTR) | REGCOM);
+
+   uint8_t oldSREG = SREG;
+   cli();
+   this->transferSamples = this->telemetry.samples;
+   SREG = oldSREG;
+   this->transferStart = millis();
+   this->transferChecked = this->transferStart;
+   this->transferState = transfer_busy;
+   return true;
+}
+
+// pollEncoderTransfer: checks on the register communication started by 
+//                      requestEncoderRead() or requestEncoderWrite(). The end
+//                      of it is seen in the STATUS_REG read along with every 
+//                      frame, so this only reads STATUS_REG itself when no 
+//                      frames have been read for REGISTER_STATUS_INTERVAL (or
+//                      the CRC is checked in software). That read clears EOT,
+//                      so the next frame may be counted as stale.
+// Parameters: None
+// returns: the state of the transfer, one of enum registerTransfer
+MB4Driver::registerTransfer MB4Driver::pollEncoderTransfer(){
+   if (this->transferState != transfer_busy){
+      return this->transferState;
+   }
+
+   uint8_t oldSREG = SREG;
+   cli();
+   uint32_t samples = this->telemetry.samples;
+   SREG = oldSREG;
+
+   unsigned long now = millis();
+   if (samples != this->transferSamples){
+      this->transferSamples = samples;
+      this->transferChecked = now;
+   }
+   if (this->softwareCRC || now - this->transferChecked >= REGISTER_STATUS_INTERVAL){
+      uint8_t mb4Status = this->readRegister(STATUS_REG, 1);
+      oldSREG = SREG;
+      cli();
+      this->recordMB4Status(mb4Status);
+      SREG = oldSREG;
+      this->transferChecked = now;
+   }
+
+   uint8_t status = this->transferStatus;
+   if (status & STATUS_NREGERR){
+      this->transferState = transfer_failed;
+   }
+   else if (status & STATUS_REGEND){
+      this->transferState = transfer_done;
+   }
+   else if (now - this->transferStart >= REGISTER_TIMEOUT){
+      this->transferState = transfer_failed;
+   }
+
+   return this->transferState;
+}
+
+// readEncoderData: collects the registers read by a finished 
+//                  requestEncoderRead() from RDATA in a single burst, which 
+//                  ends the transfer
+// Parameters:
+// data: an array of bytes to read the registers into
+// count: the number of registers to collect, up to the number requested
+// returns: false if no finished read was waiting
+bool MB4Driver::readEncoderData(uint8_t* data, uint8_t count){
+   if (this->transferState != transfer_done || count > REGISTER_DATA_SIZE){
+      return false;
+   }
+
+   this->readRegister(RDATA, data, count);
+   this->transferState = transfer_idle;
+   return true;
+}
 
 // convertRawPosition: converts the raw position readings of the encoder (bits)
-//                    into a decimal number in inches
+//                    into a decimal number in inches. The conversion itself is
+//                    done by convertRawPositionFixed().
 // Parameters:
 // rawPos: The raw position in bits 
 // offset: The offset distance in inches to acheive 0 (some encoder strips don't
 //          start at 0)
 // returns: a float representing the position in inches on the encoder strip
 float MB4Driver::convertRawPosition(uint32_t rawPos, float offset){
-   return (float)(rawPos)*CONV_FAC - offset;
+   return this->convertRawPositionFixed(rawPos, 0) * (1.0 / POSITION_UNITS_PER_INCH) 
+          - offset;
 }
 
 // getPosition: gets the current position of the encoder in inches. This function
@@ -430,19 +1917,27 @@ float MB4Driver::convertRawPosition(uint32_t rawPos, float offset){
 // Parameters: None
 // returns: a float representing the position of the encoder in inches
 float MB4Driver::getPosition(){
-   // get the current position in inches from the encoder
-   float position = this->convertRawPosition(this->getRawPosition(), this->offset);
-   // For some reason, the position will suddenly jump to <100 if the encoder 
-   // goes off the strip
-   if (position > 10.0 && position < 100) {
-      position -= 85.60; // cover the case of barely going off the strip
-   }
-   else if (position > 190) {
-      position -= 200; // cover the case of the 200 range
-   }
+   MB4_TRACE_CALL_BEGIN();
+
+   // Read the current position from the encoder
+   this->getRawPosition();
+
+   float position = this->getLastPosition();
+   MB4_TRACE_CALL_END();
    return position;
 }
 
+// getLastPosition: gets the position of the encoder in inches from the last 
+//                  valid reading, without communicating with the MB4. This is
+//                  useful with interrupt acquisition, where the readings come 
+//                  from readSample(). The float is only made from the integer
+//                  position at the very end, for display.
+// Parameters: None
+// returns: a float representing the last position of the encoder in inches
+float MB4Driver::getLastPosition(){
+   return this->getLastPositionFixed() * (1.0 / POSITION_UNITS_PER_INCH);
+}
+
 // printImportantRegisters: A function to print all of the important registers that 
 //                          must be configured in order for a single encoder sensor
 //                          to be used in a polling scheme. This function is useful 
@@ -512,9 +2007,7 @@ void MB4Driver::printImportantRegisters(){
 void MB4Driver::printSCDATA1Registers(){
 
    // Lock the bank before reading SCDATA1 to prevent data corruption
-   uint8_t currentInstruction = this->readRegister(INSTR, 1);
-   currentInstruction |= (1 << 6);
-   this->writeInstruction(currentInstruction);
+   this->lockBank();
 
    // Print out all the SCDATA1 registers for debugging 
    Serial.print("00: ");
@@ -542,10 +2035,79 @@ void MB4Driver::printSCDATA1Registers(){
    Serial.println(this->readRegister(0x07, 1), HEX);
 
    // Unlock the bank after reading SCDATA1 to allow the registers to update
-   currentInstruction = this->readRegister(INSTR, 1);
-   currentInstruction &= ~(1 << 6);
-   this->writeInstruction(currentInstruction);
+   this->unlockBank();
+
+}
 
+// printHealth: Function for printing the health record over Serial, using
+//              the same messages that used to be printed with every reading.
+//              Nothing is read from the MB4, call refreshHealth() first for
+//              up to date CDM registers.
+// Parameters: None
+// returns: nothing
+void MB4Driver::printHealth(){
+   Health health = this->getHealth();
+
+   Serial.println();
+   Serial.println("------ MB4 Health ------");
+
+   Serial.print("Encoder:\t");
+   if (health.state == no_errors) {
+      Serial.println("NO ERRORS");
+   }
+   else if (health.state == invalid_crc) {
+      Serial.println("INVALID CRC");
+   }
+   else if (health.state == encoder_warning) {
+      Serial.println("ENCODER WARNING");
+   }
+   else {
+      Serial.println("ENCODER ALARM");
+   }
+
+   Serial.print("F0:\t");
+   Serial.print(health.mb4Status, HEX);
+   Serial.print("\t| Errors: ");
+   Serial.println(health.mb4Errors, HEX);
+
+   Serial.print("F3:\t");
+   Serial.print(health.cdmTimeout, HEX);
+   Serial.print("\t| F8: ");
+   Serial.print(health.cdsStatus0, HEX);
+   Serial.print("\t| F9: ");
+   Serial.println(health.cdsStatus1, HEX);
+
+   Serial.println("------ End of MB4 Health -------");
+}
+
+// printTelemetry: Function for printing the telemetry over Serial on a 
+//                 single line, so that it can be logged and parsed easily. 
+//                 The line is "T," followed by samples, CRC errors, warnings, 
+//                 alarms, stale frames, retries and then the LATENCY_BUCKETS
+//                 counts of the read time histogram, all comma separated.
+// Parameters: None
+// returns: nothing
+void MB4Driver::printTelemetry(){
+   Telemetry telemetry = this->getTelemetry();
+
+   Serial.print("T,");
+   Serial.print(telemetry.samples);
+   Serial.print(',');
+   Serial.print(telemetry.crcErrors);
+   Serial.print(',');
+   Serial.print(telemetry.warnings);
+   Serial.print(',');
+   Serial.print(telemetry.alarms);
+   Serial.print(',');
+   Serial.print(telemetry.staleFrames);
+   Serial.print(',');
+   Serial.print(telemetry.retries);
+
+   for(uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++){
+      Serial.print(',');
+      Serial.print(telemetry.latency[bucket]);
+   }
+   Serial.println();
 }
 
 // printVersion: Function to use for printing the version of the MB4 ic
@@ -40,33 +40,196 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#ifndef MB4_DRIVER_H
+#define MB4_DRIVER_H
+
 #include <SPI.h>
 
+#include "sample-buffer.h"
+#include "mb4-crc.h"
+#include "mb4-trace.h"
+#include "position-observer.h"
+#include "position-decimator.h"
+#include "calibration-table.h"
+
 // Conversion factor to go from raw position to physical
 // this is 2^26 (26 bits max from encoder)
 #define CONV_FAC     .000000244*39.3701 // inches
 
+// Units of the integer (position_t) position pipeline. To change units, 
+// define POSITION_UNITS as one of these before this header is included.
+#define POSITION_UNITS_MICROINCH    0
+#define POSITION_UNITS_MICROMETRE   1
+#define POSITION_UNITS_NANOMETRE    2  // only reaches 2.1 m before overflowing
+
+#ifndef POSITION_UNITS
+#define POSITION_UNITS   POSITION_UNITS_MICROINCH
+#endif
+
+// Length of one count of the encoder in nanometres, as a fraction. This is 
+// the same resolution that CONV_FAC uses.
+#define COUNT_NM_NUM    244
+#define COUNT_NM_DEN    1
+
+// Length of one position unit in nanometres, as a fraction, and the number 
+// of fractional bits used for the scale from counts to units. The fractional
+// bits are chosen so the scale uses as much of 32 bits as it can.
+#if POSITION_UNITS == POSITION_UNITS_MICROINCH
+#define UNIT_NM_NUM              254
+#define UNIT_NM_DEN              10
+#define POSITION_SCALE_SHIFT     28
+#define POSITION_UNITS_PER_INCH  1000000L
+#elif POSITION_UNITS == POSITION_UNITS_MICROMETRE
+#define UNIT_NM_NUM              1000
+#define UNIT_NM_DEN              1
+#define POSITION_SCALE_SHIFT     32
+#define POSITION_UNITS_PER_INCH  25400L
+#elif POSITION_UNITS == POSITION_UNITS_NANOMETRE
+#define UNIT_NM_NUM              1
+#define UNIT_NM_DEN              1
+#define POSITION_SCALE_SHIFT     24
+#define POSITION_UNITS_PER_INCH  25400000L
+#else
+#error "POSITION_UNITS must be one of the POSITION_UNITS_ settings"
+#endif
+
+// Position units per count, with POSITION_SCALE_SHIFT fractional bits
+#define POSITION_SCALE  ((COUNT_NM_NUM * UNIT_NM_DEN * (1ULL << POSITION_SCALE_SHIFT) \
+                          + COUNT_NM_DEN * UNIT_NM_NUM / 2) / (COUNT_NM_DEN * UNIT_NM_NUM))
+
+#if POSITION_SCALE > 0xFFFFFFFF
+#error "POSITION_SCALE does not fit in 32 bits, lower POSITION_SCALE_SHIFT"
+#endif
+
+// Converts a distance in inches to position units at compile time
+#define INCHES_TO_POSITION(inches)   ((position_t)((inches) * POSITION_UNITS_PER_INCH))
+
+// Largest distance a position_t holds, in inches (only about 84 in when in 
+// nanometres), and a check that a constant in inches fits, for static_assert
+#define POSITION_MAX_INCHES   (2147483647.0 / POSITION_UNITS_PER_INCH)
+#define INCHES_FIT_POSITION(inches)   ((inches) < POSITION_MAX_INCHES && \
+                                       (inches) > -POSITION_MAX_INCHES)
+
+// A position in POSITION_UNITS
+typedef int32_t position_t;
+
 // The BREAK instruction stops all ongoing processes of the MB4
 #define BREAK     0b10000000
 
 // The INIT instruction sends out an MA pulse train on all MA clock lines
 #define INIT      0b00010000
 
+// The HOLDBANK instruction bit locks the sensor data banks so that they 
+// are not updated by the MB4 while being read
+#define HOLDBANK  0b01000000
+
+// The AGS instruction bit has the MB4 automatically start read cycles
+#define AGS       0b00000001
+
+// The REGCOM instruction (bit 3:1 of INSTR) has the MB4 carry out the 
+// register communication set up in SLAVEID, REGADR and REGNUM. The control 
+// frame is sent one CDM bit per cycle alongside the sensor data, and the 
+// instruction bits clear themselves once it has finished.
+#define REGCOM    0b00000010
+#define INSTR_COMMAND_BITS   0b00001110
+
 // Define Channel 1 as in use and Channel 2 as not active
 #define CH1         0x01
 
+// Bit to be or'd into CHSEL to also use Channel 2
+#define CH2         0x02
+
+// The MB4 has a SCDATA bank and a set of configuration registers for each of
+// up to 8 slaves. The slaves of Channel 1 come first, followed by the slaves
+// of Channel 2.
+#define MAX_SLAVES         8
+#define SCDATA_SIZE        8  // bytes in each slave's SCDATA bank
+#define SLAVE_CONFIG_SIZE  4  // bytes of configuration for each slave
+
+// Default SPI clock for talking to the MB4 in Hz. calibrateSPIClock() can 
+// find a faster clock that is still reliable with the wiring in use.
+#define SPI_CLOCK    1000000
+
+// The fastest SPI clock the MB4 accepts in Hz
+#define MAX_SPI_CLOCK   10000000
+
+// Longest time to wait for the first valid frame after the MB4 is 
+// configured, in milliseconds
+#define FIRST_FRAME_TIMEOUT   1000
+
+// Number of bytes in RDATA, which is the most encoder registers a single 
+// register communication can read or write
+#define REGISTER_DATA_SIZE   64
+
+// Longest time to wait for register communication to finish, in milliseconds
+#define REGISTER_TIMEOUT     100
+
+// Time without any frames being read after which pollEncoderTransfer() reads
+// STATUS_REG itself, in milliseconds
+#define REGISTER_STATUS_INTERVAL   5
+
+// Registers of every BiSS C slave, as laid out by the BiSS standard. A slave
+// has BISS_REGISTERS registers, the first 64 of which are left to the slave.
+#define BISS_REGISTERS              128
+#define BISS_SERIAL_NUMBER          0x44
+#define BISS_SERIAL_NUMBER_SIZE     4
+#define BISS_DEVICE_ID              0x78
+#define BISS_DEVICE_ID_SIZE         6
+#define BISS_MANUFACTURER_ID        0x7E
+#define BISS_MANUFACTURER_ID_SIZE   2
+
+// Number of times each check is repeated at every clock tried while 
+// calibrating the SPI clock
+#define SPI_CALIBRATION_TRIALS   16
+
+// Number of buckets in the read time histogram. Bucket n counts reads that 
+// took 2^n to 2^(n+1)-1 microseconds (bucket 0 also counts 0), and the last 
+// bucket counts every read that took longer.
+#define LATENCY_BUCKETS   16
+
 // The correct setting for bit 4:0 of the 
 // FREQ register for a 20/8 MHz clock
 #define CLOCK_SPEED 0x03
 
-// Setting for the BiSS C protocol to go in bit 6 of REGVERS
-// and into bit 1:0 of CFGCH1
+// Frequency of the clock the MB4 runs from in Hz. The MA clock is this 
+// divided by 2*(FREQS + 1).
+#define MB4_CLOCK   20000000UL
+
+// Setting for the BiSS C protocol to go into bit 3:0 of CFGCH1 and CFGCH2
 #define BISS_C       5
 
+// Setting for BiSS C register communication to go in bit 6 of REGVERS
+#define REGVERS_BISS_C   1
+
 // Setting for automatically restarting read cycles
 // to go into the FREQAGS register (set exactly to this)
 #define AGSFREQ   0x81
 
+// The AGS cycle period set by FREQAGS is (bit 6:0 + 1) steps, which are 
+// coarse steps when bit 7 is set
+#define AGS_FINE_STEP     1     // in microseconds
+#define AGS_COARSE_STEP   100   // in microseconds
+#define AGS_COARSE        0x80
+#define AGS_MAX_STEPS     128
+
+// MA clock cycles of a frame: the data and CRC6 of each slave, and the 
+// acknowledge, start, CDS and stop bits of the whole frame
+#define FRAME_SLAVE_BITS      ((DATA_LENGTH + 1) + 6)
+#define FRAME_OVERHEAD_BITS   4
+
+// Time the encoders need after a frame before the next one can start (the 
+// BiSS timeout), in microseconds
+#define ENCODER_TIMEOUT       20
+
+// How often the adaptive cycle rate checks the velocity, in milliseconds, and
+// how far below the fast velocity it has to drop to slow back down
+#define ADAPTIVE_INTERVAL     50
+#define ADAPTIVE_HYSTERESIS   2  // the velocity is divided by this
+
+// Longest time captureBurst() waits for a cycle to end before giving up on 
+// the rest of the burst, in milliseconds
+#define BURST_TIMEOUT   20
+
 // Setting for RS422 line levels to be or'd into 
 // bit 3:2 of the CFGIF register
 #define RS422     0x02
@@ -96,34 +259,76 @@
 #define READ_STATUS  0x05
 #define WRITE_INSTRUCTION 0x07
 #define READ_DATA0   0x09  // 0 Provides fast access to read 
-#define WRITE_DATA0  0x0B
+#define WRITE_DATA0  0x0B  // the data banks from address 0x00 (no address byte)
 
 // Register addresses to read from the IC Haus MB4 Chip
 // Please refer to the datasheet, as the same names for the 
 // registers are used here that are in the datasheet
 #define SCDATA1   0x00
 #define SCDATA1_CRC  0x07
+#define SCDATA_CRC_OFFSET  (SCDATA1_CRC - SCDATA1)
+#define RDATA     0x80 // REGISTER_DATA_SIZE bytes
 #define ENSCD1    0xC0
 #define SCDLEN1   0xC0
 #define SELCRCS1  0xC1 // bit 7
 #define SCRCLEN1  0xC1 // bit 6:0
 #define SCRCSTART1   0xC2 // bit 15:0
+#define SLAVEID   0xE0 // bit 2:0, CTS in bit 7
+#define REGADR    0xE1 // bit 6:0, WNR in bit 7
+#define REGNUM    0xE2 // bit 5:0
 #define CHSEL     0xE4
 #define REGVERS   0xE5 
 #define FREQ      0xE6
 #define FREQAGS   0xE8
 #define REVISION  0xEA
 #define VERSION   0xEB
+#define CFGCH2    0xEC
 #define CFGCH1    0xED
 #define ACTnSENS  0xEF
 #define STATUS_REG   0xF0
-#define SVALID    0xF1
+#define SVALID    0xF1 // 2 bits per slave, 4 slaves per register
 #define CDMTIMEOUT   0xF3
 #define INSTR     0xF4
 #define CFGIF     0xF5
 #define CDS_STATUS0  0xF8
 #define CDS_STATUS1  0xF9
 
+// Bits of STATUS_REG. Reading STATUS_REG clears the bits latched by the MB4.
+// The error bits starting with N are low active.
+#define STATUS_EOT           0x01  // End of the last read cycle
+#define STATUS_REGEND        0x02  // Register communication finished
+#define STATUS_NREGERR       0x04  // Register communication failed
+#define STATUS_SWBANKFAILS   0x08  // A bank switch was missed
+#define STATUS_NAGSERR       0x10  // An AGS cycle could not be started in time
+#define STATUS_NDELAYERR     0x20  // Line delay could not be measured
+#define STATUS_NSCDERR       0x40  // Single cycle data had an error
+#define STATUS_NERR          0x80  // Any error, as on the NER pin
+
+// Error bits of STATUS_REG, and those of them that are low active
+#define STATUS_ERROR_BITS    (STATUS_NREGERR | STATUS_SWBANKFAILS | STATUS_NAGSERR \
+                              | STATUS_NDELAYERR | STATUS_NSCDERR | STATUS_NERR)
+#define STATUS_LOW_ACTIVE    (STATUS_NREGERR | STATUS_NAGSERR | STATUS_NDELAYERR \
+                              | STATUS_NSCDERR | STATUS_NERR)
+
+// Gives the error bits of a STATUS_REG value, with every error set when active
+#define STATUS_ERRORS(status)   (((status) ^ STATUS_LOW_ACTIVE) & STATUS_ERROR_BITS)
+
+// Range of registers that the MB4Driver keeps a shadow copy of. This covers
+// the configuration registers, INSTR and CFGIF. The status registers within
+// this range (STATUS_REG through CDMTIMEOUT) are changed by the MB4 itself and 
+// are never shadowed.
+#define SHADOW_START    0xC0
+#define SHADOW_END      CFGIF
+#define SHADOW_SIZE     (SHADOW_END - SHADOW_START + 1)
+
+// Register used as a scratch register while calibrating the SPI clock. This 
+// is the CRC start value of the last slave, which is unused unless the MB4 
+// has all MAX_SLAVES slaves connected.
+#define SCRATCH_REG     (SCRCSTART1 + (MAX_SLAVES - 1)*SLAVE_CONFIG_SIZE)
+
+// Typed descriptions of the fields within the registers above
+#include "mb4-registers.h"
+
 // MB4Driver class: a class for communicating with the IC-MB4 master from 
 //                iC Hause over SPI. This class also implements methods for
 //                reading a Renishaw LMA10 absolute magnetic encoder that is 
@@ -138,12 +343,23 @@
 // For all functions, see the comment above each one in the source file (.cpp) for a more in
 // depth explanation. 
 class MB4Driver {
+   // The bus scheduler opens a single SPI transaction for several drivers
+   friend class MB4Bus;
+
    // Private methods are for use only within other methods in the MB4Driver
    // class.
    private:
       // The SPI chip select pin that the IC-MB4 is connected to
       uint8_t selectPin;
 
+      // Set while an MB4Bus holds an SPI transaction open for all drivers
+      static bool batchOpen;
+
+      void beginTransfer();
+
+      void endTransfer();
+
+   public:
       // The different status states the MB4 can have. This status also contains
       // status interpretations that are specific to the Renishaw LMA10 encoder
       enum status
@@ -152,39 +368,396 @@ class MB4Driver {
          encoder_alarm,    // Invalid position data from encoder
          encoder_warning,  // Warning from the encoder (close to overspeed?)
          invalid_crc       // Cyclic check sum reported incorrectly
+      };
+
+      // The states of register communication with an encoder, as returned by
+      // pollEncoderTransfer()
+      enum registerTransfer
+      {
+         transfer_idle,    // Nothing requested, or the data was collected
+         transfer_busy,    // The control frame is still being sent
+         transfer_done,    // Finished, read data is waiting in RDATA
+         transfer_failed   // The slave did not answer, or it took too long
+      };
+
+      // PositionFrame: one complete snapshot of a slave's SCDATA bank (for 
+      //                the first slave SCDATA1 through SCDATA1_CRC) along with
+      //                its SVALID bits, as returned by readPositionFrame()
+      struct PositionFrame
+      {
+         uint32_t rawPosition;   // Position in bits with status bits shifted out
+         uint8_t encoderStatus;  // Error and warning bits from the encoder (bit 1:0)
+         uint8_t crc;            // The CRC byte held at the end of the bank
+         uint8_t svalid;         // The SVALID bits of this slave (2 is valid), or
+                                 // the software CRC check written the same way
+      };
+
+      // Health: the combined state of the encoder and the MB4, as returned by
+      //         getHealth(). The encoder fields and the STATUS_REG fields come
+      //         from the frames already being read, the CDM fields are only 
+      //         read by refreshHealth().
+      struct Health
+      {
+         uint8_t state;          // The status of the encoder, one of enum status
+         uint8_t encoderStatus;  // Error and warning bits of the last frame checked
+         bool crcValid;          // Whether the last frame checked had a correct CRC
+         uint8_t mb4Status;      // STATUS_REG as read along with the last frame
+         uint8_t mb4Errors;      // STATUS_ERRORS() of every STATUS_REG read since 
+                                 // clearHealth(), or'd together
+         uint8_t cdmTimeout;     // CDMTIMEOUT as of the last refreshHealth()
+         uint8_t cdsStatus0;     // CDS_STATUS0 as of the last refreshHealth()
+         uint8_t cdsStatus1;     // CDS_STATUS1 as of the last refreshHealth()
+      };
+
+      // Telemetry: counts kept by the driver since resetTelemetry(), as 
+      //            returned by getTelemetry(). The 16 bit counts stop at 65535.
+      struct Telemetry
+      {
+         uint32_t samples;       // Number of times frames were read
+         uint16_t crcErrors;     // Number of frames checked with an invalid CRC,
+         uint16_t warnings;      // an encoder warning or an encoder alarm
+         uint16_t alarms;        
+         uint16_t staleFrames;   // Frames read before the MB4 finished a new cycle
+         uint16_t retries;       // Number of times start up was restarted
+         uint16_t latency[LATENCY_BUCKETS]; // Histogram of read times in us
+      };
+
+   private:
+      // currentStatus will hold the status 
+      status currentStatus;
+
+      // The record of the health of the encoder and the MB4. Only the 
+      // STATUS_REG fields are written by the end of transmission interrupt.
+      Health health;
 
-      } currentStatus; // currentStatus will hold the status 
+      void recordMB4Status(uint8_t mb4Status);
+
+      // Counts kept since resetTelemetry(). The end of transmission interrupt
+      // writes the samples, staleFrames and latency counts.
+      Telemetry telemetry;
+
+      void recordLatency(uint32_t readTime);
 
       // For descriptions of these two functions please see source file
-      uint8_t checkStatus_unprotected();
+      uint8_t checkStatus(uint8_t encoderStatus, bool valid);
+
+      // Shadow copy of the writable registers of the MB4, starting at 
+      // SHADOW_START, and a bit per register marking if the copy is valid
+      uint8_t shadowRegisters[SHADOW_SIZE];
+      uint8_t shadowValid[(SHADOW_SIZE + 7) / 8];
+
+      bool isShadowed(uint8_t registerAddress);
+
+      void updateShadow(uint8_t registerAddress, uint8_t data);
+
+      // Whether the configuration was read back correctly after uploading
+      bool configured;
+
+      void stageRegister(uint8_t registerAddress, uint8_t data);
+
+      // stageFields: sets fields of a register in the shadow copy only, ready
+      //              for uploadConfiguration() to write it to the MB4
+      template<uint8_t ADDRESS, uint8_t MASK>
+      void stageFields(FieldWrite<ADDRESS, MASK> fields){
+         static_assert(ADDRESS >= SHADOW_START && ADDRESS <= SHADOW_END, 
+                       "only shadowed registers can be staged");
+         uint8_t& staged = this->shadowRegisters[ADDRESS - SHADOW_START];
+         staged = (staged & ~MASK) | fields.bits;
+      }
+
+      // stageSlaveConfig: stages the SCD and CRC configuration of slave SLAVE
+      //                   and of every slave after it, up to slaveCount. The
+      //                   slave number has to be known at compile time to
+      //                   pick its fields, so each slave stages the next.
+      template<uint8_t SLAVE>
+      void stageSlaveConfig(uint8_t slaveCount){
+         if (SLAVE >= slaveCount) {
+            return;
+         }
+         this->stageFields(MB4Fields::ScdLen<SLAVE>::set(DATA_LENGTH) |
+                           MB4Fields::EnScd<SLAVE>::set(SCD_AVAIL));
+         this->stageFields(MB4Fields::SelCrcS<SLAVE>::set(CRC_SELECT) |
+                           MB4Fields::SCrcLen<SLAVE>::set(CRC_POLY));
+         this->stageFields(MB4Fields::SCrcStartLow<SLAVE>::set(CRC_START & 0xFF));
+         this->stageFields(MB4Fields::SCrcStartHigh<SLAVE>::set(CRC_START >> 8));
+         this->stageSlaveConfig<SLAVE + 1>(slaveCount);
+      }
+
+      bool uploadConfiguration();
+
+      // The steps of starting up the MB4, see poll()
+      enum startupStep
+      {
+         startup_idle,        // begin() has not been called
+         startup_break,       // Stop anything the MB4 was doing
+         startup_configure,   // Upload and check the configuration
+         startup_enable_ags,  // Start the automatic read cycles
+         startup_wait_frame,  // Wait for the first valid frame
+         startup_ready,       // Ready for readings
+         startup_failed       // No valid frame arrived in time
+
+      } currentStep; // currentStep holds the next step to be run
+
+      // When the wait for the first frame started
+      unsigned long startupTime;
+
+      // Whether to print the configuration over Serial once started
+      bool verbose;
+
+      void finishStartup();
+
+      void lockBank();
+
+      void unlockBank();
 
       uint32_t currentRawPosition;
 
-      // Class member variable that will hold the offset for the encoder
+      // Number of slaves in the chain of each channel
+      uint8_t channel1Slaves;
+      uint8_t channel2Slaves;
+
+      void readFrames(PositionFrame* frames, uint8_t numSlaves);
+
+      // Whether checkCycleEnd() saw EOT since frames were last read, in which
+      // case the next frames aren't stale even though reading STATUS_REG 
+      // cleared EOT
+      bool cycleEnded;
+
+      bool checkCycleEnd();
+
+      // Whether frames are read with the fast access READ_DATA0 command
+      bool fastAccess;
+
+      // Whether the CRC of each frame is checked here instead of reading SVALID
+      bool softwareCRC;
+
+      // The SPI clock in Hz and the settings used for every transaction, 
+      // which are only worked out when the clock changes
+      uint32_t spiClock;
+      SPISettings spiSettings;
+
+      bool checkSPIClock(uint8_t version, uint8_t revision, bool useScratch);
+
+      // Interrupt driven acquisition: the buffer that captured samples are 
+      // placed into and the interrupt that captures them
+      SampleBuffer* acquisitionBuffer;
+      int8_t acquisitionInterrupt;
+
+      // Observer given every valid sample collected by readSample(), if any
+      PositionObserver* observer;
+
+      // Decimator given every valid sample collected by readSample(), if any
+      PositionDecimator* decimator;
+
+      // The driver that the end of transmission interrupt captures frames for
+      static MB4Driver* acquiringDriver;
+
+      static void endOfTransmissionISR();
+
+      // Class member variable that will hold the offset for the encoder, in 
+      // inches and in position units
       float offset;
+      position_t offsetFixed;
+
+      // Correction of positions on the encoder strip, in position units
+      CalibrationTable calibration;
+
+      // FREQS and FREQAGS, uploaded while starting up and written straight 
+      // away once started
+      uint8_t freqS;
+      uint8_t freqAgs;
+
+      // Adaptive cycle rate, see setAdaptiveRate(). The fast period is 0 
+      // when it is off.
+      uint32_t adaptiveFastPeriod;
+      uint32_t adaptiveSlowPeriod;
+      position_t adaptiveVelocity;
+      bool adaptiveFast;
+      unsigned long adaptiveChecked;
+
+      void adaptRate();
+
+      // Register communication with the encoders, see requestEncoderRead().
+      // REGEND and NREGERR (set when active) are latched into transferStatus
+      // from every STATUS_REG read, including those of the end of 
+      // transmission interrupt.
+      registerTransfer transferState;
+      volatile uint8_t transferStatus;
+      unsigned long transferStart;
+      unsigned long transferChecked;
+      uint32_t transferSamples;
+
+      bool startEncoderTransfer(uint8_t registerAddress, uint8_t count, 
+                                uint8_t slave, bool write);
    public:
       // For descriptions of these functions please see the source file,
       // however effort has been made to make the function names self 
       // explanatory. 
-      MB4Driver(uint8_t selectPin, float offset);
+      MB4Driver(uint8_t selectPin, float offset, uint8_t channel1Slaves = 1, 
+                uint8_t channel2Slaves = 0, bool verbose = false);
+
+      void begin();
+
+      bool poll();
+
+      bool isReady();
+
+      bool hasFailed();
+
+      bool isConfigured();
 
       uint32_t readRegister(uint8_t registerAddress, uint8_t numBytesToRead);
 
+      void readRegister(uint8_t registerAddress, uint8_t* data, uint8_t numBytesToRead);
+
       void writeRegister(uint8_t registerAddress, uint8_t* data, uint8_t numBytesToWrite);
 
       void writeRegister(uint8_t registerAddress, uint8_t data);
 
       void writeInstruction(uint8_t instruction);
 
+      void fastReadRegister(uint8_t* data, uint8_t numBytesToRead);
+
+      void fastWriteRegister(uint8_t* data, uint8_t numBytesToWrite);
+
+      void setFastAccess(bool enable);
+
+      void setSoftwareCRC(bool enable);
+
+      bool checkFrameCRC(const PositionFrame& frame);
+
+      uint8_t checkFrameCRCs(PositionFrame* frames, uint8_t numFrames);
+
+      void setSPIClock(uint32_t clock);
+
+      uint32_t setMAClock(uint32_t clock);
+
+      uint32_t getMAClock();
+
+      uint32_t getCycleTime();
+
+      uint32_t setCyclePeriod(uint32_t periodMicros);
+
+      uint32_t getCyclePeriod();
+
+      void setAdaptiveRate(uint32_t fastPeriod, uint32_t slowPeriod, 
+                           position_t fastVelocity);
+
+      uint32_t getSPIClock();
+
+      uint32_t calibrateSPIClock(uint32_t maxClock = MAX_SPI_CLOCK);
+
+      uint8_t readCachedRegister(uint8_t registerAddress);
+
+      void modifyRegister(uint8_t registerAddress, uint8_t mask, uint8_t value);
+
+      void invalidateRegister(uint8_t registerAddress);
+
+      void invalidateShadow();
+
+      void resync();
+
+      void snapshotRegisters(uint8_t* image);
+
+      // writeFields: writes one or more fields of a register, combined with |
+      //              into a single write (see mb4-registers.h). When the fields 
+      //              cover the whole register it is written without reading 
+      //              it first, otherwise the other bits come from the shadow 
+      //              copy.
+      template<uint8_t ADDRESS, uint8_t MASK>
+      void writeFields(FieldWrite<ADDRESS, MASK> fields){
+         if (MASK == 0xFF && ADDRESS != INSTR) {
+            this->writeRegister(ADDRESS, fields.bits);
+         }
+         else {
+            this->modifyRegister(ADDRESS, MASK, fields.bits);
+         }
+      }
+
+      // readField: reads the value of a single field, using the shadow copy 
+      //            of its register when it is valid
+      template<class FIELD>
+      uint8_t readField(){
+         return FIELD::get(this->readCachedRegister(FIELD::address));
+      }
+
+      PositionFrame readPositionFrame();
+
+      void readPositionFrames(PositionFrame* frames);
+
+      uint8_t getSlaveCount();
+
       uint32_t getRawPosition();
 
+      bool beginInterruptAcquisition(uint8_t interruptPin, SampleBuffer* buffer,
+                                     uint8_t edge = FALLING);
+
+      void endInterruptAcquisition();
+
+      bool readSample(Sample& sample);
+
+      uint16_t captureBurst(BurstBuffer& burst, uint16_t numSamples);
+
+      void dumpBurst(const BurstBuffer& burst, Print& out = Serial);
+
+      void setObserver(PositionObserver* observer);
+
+      void setDecimator(PositionDecimator* decimator);
+
+      Health getHealth();
+
+      Health refreshHealth();
+
+      void clearHealth();
+
+      Telemetry getTelemetry();
+
+      void resetTelemetry();
+
+      position_t convertCountsFixed(int32_t counts);
+
+      position_t convertRawPositionFixed(uint32_t rawPos, position_t offset);
+
+      position_t getPositionFixed();
+
+      position_t getLastPositionFixed();
+
+      position_t convertDecimatedFixed(const DecimatedSample& sample);
+
+      CalibrationTable& getCalibration();
+
+      bool addCalibrationReference(position_t reference);
+
+      bool requestEncoderRead(uint8_t registerAddress, uint8_t count, uint8_t slave = 0);
+
+      bool requestEncoderWrite(uint8_t registerAddress, uint8_t* data, uint8_t count,
+                               uint8_t slave = 0);
+
+      registerTransfer pollEncoderTransfer();
+
+      bool readEncoderData(uint8_t* data, uint8_t count);
+
       float convertRawPosition(uint32_t rawPos, float offset);
 
       float getPosition();
 
+      float getLastPosition();
+
       void printImportantRegisters();
 
       void printSCDATA1Registers();
 
+      void printHealth();
+
+      void printTelemetry();
+
       void printVersion();
-};
\ No newline at end of file
+};
+
+// Ends stageSlaveConfig(), the MB4 has no slave after the last one
+template<>
+inline void MB4Driver::stageSlaveConfig<MAX_SLAVES>(uint8_t slaveCount){
+   (void)slaveCount;
+}
+
+#endif
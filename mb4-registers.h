@@ -0,0 +1,141 @@
+/* mb4-registers.h
+   Typed descriptions of the fields within the registers of an IC-MB4 master IC.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MB4_REGISTERS_H
+#define MB4_REGISTERS_H
+
+#include <Arduino.h>
+
+// FieldWrite: the bits to write into some of the fields of one register. The
+// register address and the mask of every bit being written are part of the 
+// type, so combining writes with | is checked by the compiler.
+template<uint8_t ADDRESS, uint8_t MASK>
+struct FieldWrite
+{
+   static const uint8_t address = ADDRESS;
+   static const uint8_t mask = MASK;
+
+   // The bits to write, only those in MASK are ever set
+   uint8_t bits;
+
+   constexpr FieldWrite(uint8_t bits) : bits(bits) {}
+};
+
+// Combines the writes of fields in the same register into one write. Writing
+// fields from different registers, or writing the same bits twice, is 
+// rejected at compile time.
+template<uint8_t ADDRESS1, uint8_t MASK1, uint8_t ADDRESS2, uint8_t MASK2>
+constexpr FieldWrite<ADDRESS1, MASK1 | MASK2> operator|(FieldWrite<ADDRESS1, MASK1> first,
+                                                        FieldWrite<ADDRESS2, MASK2> second){
+   static_assert(ADDRESS1 == ADDRESS2, "only fields in the same register can be combined");
+   static_assert((MASK1 & MASK2) == 0, "fields being combined overlap");
+   return FieldWrite<ADDRESS1, MASK1 | MASK2>(first.bits | second.bits);
+}
+
+// RegisterField: describes a field of WIDTH bits starting at bit OFFSET of the
+//                register at ADDRESS
+template<uint8_t ADDRESS, uint8_t OFFSET, uint8_t WIDTH>
+struct RegisterField
+{
+   static_assert(WIDTH > 0 && OFFSET + WIDTH <= 8, "field must fit in one register");
+
+   static const uint8_t address = ADDRESS;
+   static const uint8_t offset = OFFSET;
+   static const uint8_t width = WIDTH;
+   static const uint8_t mask = ((1 << WIDTH) - 1) << OFFSET;
+
+   // set: the write that puts value into this field
+   static constexpr FieldWrite<ADDRESS, mask> set(uint8_t value){
+      return FieldWrite<ADDRESS, mask>((value << OFFSET) & mask);
+   }
+
+   // get: picks the value of this field out of the whole register
+   static constexpr uint8_t get(uint8_t registerValue){
+      return (registerValue & mask) >> OFFSET;
+   }
+};
+
+// The fields of the MB4's registers that this driver configures. The names
+// follow the datasheet. Fields that belong to a slave take the slave number,
+// starting at 0 for the first slave (so SCDLEN1 is ScdLen<0>).
+namespace MB4Fields {
+   // Slave configuration, SLAVE_CONFIG_SIZE registers per slave
+   template<uint8_t SLAVE> using ScdLen = 
+      RegisterField<SCDLEN1 + SLAVE*SLAVE_CONFIG_SIZE, 0, 6>;
+   template<uint8_t SLAVE> using EnScd = 
+      RegisterField<ENSCD1 + SLAVE*SLAVE_CONFIG_SIZE, 6, 1>;
+   template<uint8_t SLAVE> using SCrcLen = 
+      RegisterField<SCRCLEN1 + SLAVE*SLAVE_CONFIG_SIZE, 0, 7>;
+   template<uint8_t SLAVE> using SelCrcS = 
+      RegisterField<SELCRCS1 + SLAVE*SLAVE_CONFIG_SIZE, 7, 1>;
+   template<uint8_t SLAVE> using SCrcStartLow = 
+      RegisterField<SCRCSTART1 + SLAVE*SLAVE_CONFIG_SIZE, 0, 8>;
+   template<uint8_t SLAVE> using SCrcStartHigh = 
+      RegisterField<SCRCSTART1 + 1 + SLAVE*SLAVE_CONFIG_SIZE, 0, 8>;
+
+   // Master configuration
+   typedef RegisterField<CHSEL, 0, 8>     ChSel;
+   typedef RegisterField<REGVERS, 6, 1>   RegVers;
+   typedef RegisterField<FREQ, 0, 5>      FreqS;
+   typedef RegisterField<FREQAGS, 0, 8>   FreqAgs;
+   typedef RegisterField<CFGCH1, 0, 4>    CfgCh1;
+   typedef RegisterField<CFGCH2, 0, 4>    CfgCh2;
+   typedef RegisterField<ACTnSENS, 0, 8>  ActSens;
+   typedef RegisterField<CFGIF, 0, 2>     CfgIfClock;
+   typedef RegisterField<CFGIF, 2, 2>     CfgIfLevel;
+
+   // Register communication
+   typedef RegisterField<SLAVEID, 0, 3>   SlaveId;
+   typedef RegisterField<SLAVEID, 7, 1>   Cts;
+   typedef RegisterField<REGADR, 0, 7>    RegAdr;
+   typedef RegisterField<REGADR, 7, 1>    Wnr;
+   typedef RegisterField<REGNUM, 0, 6>    RegNum;
+
+   // Instruction register
+   typedef RegisterField<INSTR, 0, 1>     Ags;
+   typedef RegisterField<INSTR, 1, 3>     Instr;
+   typedef RegisterField<INSTR, 4, 1>     Init;
+   typedef RegisterField<INSTR, 6, 1>     HoldBank;
+   typedef RegisterField<INSTR, 7, 1>     Break;
+}
+
+#endif
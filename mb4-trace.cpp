@@ -0,0 +1,179 @@
+/* mb4-trace.cpp
+   Optional tracer of the SPI transactions made with the IC-MB4.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "mb4-trace.h"
+
+#ifdef MB4_TRACE
+
+TraceEntry MB4Trace::entries[MB4_TRACE_SIZE];
+uint8_t MB4Trace::count = 0;
+uint8_t MB4Trace::next = 0;
+uint32_t MB4Trace::overwritten = 0;
+TraceEntry MB4Trace::current;
+uint32_t MB4Trace::transactions = 0;
+uint32_t MB4Trace::bytes = 0;
+uint8_t MB4Trace::callDepth = 0;
+uint32_t MB4Trace::callStart = 0;
+uint32_t MB4Trace::callStartTransactions = 0;
+uint32_t MB4Trace::callStartBytes = 0;
+uint32_t MB4Trace::calls = 0;
+uint32_t MB4Trace::callTransactions = 0;
+uint32_t MB4Trace::callBytes = 0;
+uint32_t MB4Trace::callMicros = 0;
+
+// begin: starts recording a transaction, once the MB4 has been selected
+// Parameters: 
+// selectPin: the chip select pin of the MB4
+// opcode: the SPI opcode being sent
+// argument: the address, or the instruction for WRITE_INSTRUCTION
+// returns: nothing
+void MB4Trace::begin(uint8_t selectPin, uint8_t opcode, uint8_t argument){
+   current.start = micros();
+   current.selectPin = selectPin;
+   current.opcode = opcode;
+   current.argument = argument;
+}
+
+// end: finishes recording a transaction, before the MB4 is deselected, and 
+//      places it into the ring
+// Parameters: 
+// bytes: the number of bytes on the wire, the opcode included
+// returns: nothing
+void MB4Trace::end(uint8_t bytes){
+   current.duration = micros() - current.start;
+   current.bytes = bytes;
+
+   entries[next] = current;
+   next = (next + 1) % MB4_TRACE_SIZE;
+   if (count < MB4_TRACE_SIZE) {
+      count++;
+   }
+   else {
+      overwritten++;
+   }
+
+   MB4Trace::transactions++;
+   MB4Trace::bytes += bytes;
+}
+
+// beginCall: marks the start of a call that works out a position, such as 
+//            getRawPosition(). Calls made within it are part of it.
+// Parameters: None
+// returns: nothing
+void MB4Trace::beginCall(){
+   if (callDepth++ == 0) {
+      callStart = micros();
+      callStartTransactions = transactions;
+      callStartBytes = bytes;
+   }
+}
+
+// endCall: marks the end of a call started with beginCall() and adds its 
+//          transactions, bytes and time to the totals of all calls
+// Parameters: None
+// returns: nothing
+void MB4Trace::endCall(){
+   if (callDepth > 0 && --callDepth == 0) {
+      calls++;
+      callTransactions += transactions - callStartTransactions;
+      callBytes += bytes - callStartBytes;
+      callMicros += micros() - callStart;
+   }
+}
+
+// clear: forgets every transaction and call recorded
+// Parameters: None
+// returns: nothing
+void MB4Trace::clear(){
+   count = 0;
+   next = 0;
+   overwritten = 0;
+   transactions = 0;
+   bytes = 0;
+   calls = 0;
+   callTransactions = 0;
+   callBytes = 0;
+   callMicros = 0;
+}
+
+// print: prints the ring and the call totals over Serial, oldest first, in a 
+//        form that trace-decode (in simulator/) turns into a timeline:
+//          TRACE,<transactions kept>,<transactions overwritten>
+//          E,<start>,<duration>,<select pin>,<opcode>,<argument>,<bytes>
+//          CALLS,<calls>,<transactions>,<bytes>,<microseconds>
+//        with opcode and argument in hex and the rest in decimal.
+// Parameters: None
+// returns: nothing
+void MB4Trace::print(){
+   Serial.print("TRACE,");
+   Serial.print(count);
+   Serial.print(',');
+   Serial.println(overwritten);
+
+   uint8_t index = (next + MB4_TRACE_SIZE - count) % MB4_TRACE_SIZE;
+   for(uint8_t entry = 0; entry < count; entry++){
+      TraceEntry& traced = entries[index];
+      Serial.print("E,");
+      Serial.print(traced.start);
+      Serial.print(',');
+      Serial.print(traced.duration);
+      Serial.print(',');
+      Serial.print(traced.selectPin);
+      Serial.print(',');
+      Serial.print(traced.opcode, HEX);
+      Serial.print(',');
+      Serial.print(traced.argument, HEX);
+      Serial.print(',');
+      Serial.println(traced.bytes);
+      index = (index + 1) % MB4_TRACE_SIZE;
+   }
+
+   Serial.print("CALLS,");
+   Serial.print(calls);
+   Serial.print(',');
+   Serial.print(callTransactions);
+   Serial.print(',');
+   Serial.print(callBytes);
+   Serial.print(',');
+   Serial.println(callMicros);
+}
+
+#endif
@@ -0,0 +1,125 @@
+/* mb4-trace.h
+   Optional tracer of the SPI transactions made with the IC-MB4.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef MB4_TRACE_H
+#define MB4_TRACE_H
+
+#include <Arduino.h>
+
+// Uncomment to record every SPI transaction made by the MB4Driver. With this
+// left undefined the tracer compiles to nothing.
+// #define MB4_TRACE
+
+// Number of transactions kept. Each takes 10 bytes of RAM.
+#ifndef MB4_TRACE_SIZE
+#define MB4_TRACE_SIZE   32
+#endif
+
+#ifdef MB4_TRACE
+
+// TraceEntry: a single SPI transaction with the MB4
+struct TraceEntry
+{
+   uint32_t start;      // micros() once the MB4 was selected
+   uint16_t duration;   // Time until it was deselected in microseconds
+   uint8_t selectPin;   // Chip select pin of the MB4 talked to
+   uint8_t opcode;      // The SPI opcode sent
+   uint8_t argument;    // The address, or the instruction for WRITE_INSTRUCTION
+   uint8_t bytes;       // Bytes on the wire, the opcode included
+};
+
+// MB4Trace class: a ring of the most recent SPI transactions, shared by every
+//                 MB4Driver, along with totals of the transactions made while
+//                 a driver is working out a position (see beginCall()). Once 
+//                 the ring is full the oldest transactions are overwritten.
+class MB4Trace {
+   private:
+      static TraceEntry entries[MB4_TRACE_SIZE];
+      static uint8_t count;
+      static uint8_t next;
+      static uint32_t overwritten;
+
+      // The transaction in progress
+      static TraceEntry current;
+
+      // Totals of every transaction, and of the calls being summarised
+      static uint32_t transactions;
+      static uint32_t bytes;
+      static uint8_t callDepth;
+      static uint32_t callStart;
+      static uint32_t callStartTransactions;
+      static uint32_t callStartBytes;
+      static uint32_t calls;
+      static uint32_t callTransactions;
+      static uint32_t callBytes;
+      static uint32_t callMicros;
+
+   public:
+      static void begin(uint8_t selectPin, uint8_t opcode, uint8_t argument);
+
+      static void end(uint8_t bytes);
+
+      static void beginCall();
+
+      static void endCall();
+
+      static void clear();
+
+      static void print();
+};
+
+// Hooks used by the MB4Driver around each transaction and each call that 
+// works out a position
+#define MB4_TRACE_BEGIN(opcode, argument)   MB4Trace::begin(this->selectPin, opcode, argument)
+#define MB4_TRACE_END(bytes)                MB4Trace::end(bytes)
+#define MB4_TRACE_CALL_BEGIN()              MB4Trace::beginCall()
+#define MB4_TRACE_CALL_END()                MB4Trace::endCall()
+
+#else
+
+#define MB4_TRACE_BEGIN(opcode, argument)
+#define MB4_TRACE_END(bytes)
+#define MB4_TRACE_CALL_BEGIN()
+#define MB4_TRACE_CALL_END()
+
+#endif
+
+#endif
@@ -0,0 +1,162 @@
+/* position-decimator.cpp
+   Integer CIC decimation of encoder samples into a slower, finer position stream.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "position-decimator.h"
+
+// PositionDecimator constructor: sets up an empty decimator
+// Parameters: 
+// ratio: the number of samples taken in for each position given out
+// order: (optional parameter) the number of integrator and comb stages, from
+//        1 up to DECIMATOR_MAX_ORDER
+PositionDecimator::PositionDecimator(uint8_t ratio, uint8_t order){
+   this->ratio = ratio < 1 ? 1 : ratio;
+   this->order = order < 1 ? 1 : (order > DECIMATOR_MAX_ORDER ? DECIMATOR_MAX_ORDER : order);
+
+   this->gain = 1;
+   for(uint8_t stage = 0; stage < this->order; stage++){
+      this->gain *= this->ratio;
+   }
+
+   this->missed = 0;
+   this->reset();
+}
+
+// update: takes in a sample. Samples should arrive at a steady rate, such as
+//         those captured on the end of transmission interrupt.
+// Parameters: 
+// timestamp: micros() when the sample was taken
+// rawPosition: the position of the sample in counts
+// returns: nothing
+void PositionDecimator::update(uint32_t timestamp, uint32_t rawPosition){
+   // Integrate at the input rate
+   uint64_t value = rawPosition;
+   for(uint8_t stage = 0; stage < this->order; stage++){
+      this->integrators[stage] += value;
+      value = this->integrators[stage];
+   }
+
+   if (this->phase == 0) {
+      this->blockTimestamp = timestamp;
+   }
+   if (++this->phase < this->ratio) {
+      return;
+   }
+   this->phase = 0;
+
+   // Comb at the output rate
+   for(uint8_t stage = 0; stage < this->order; stage++){
+      uint64_t previous = this->combs[stage];
+      this->combs[stage] = value;
+      value -= previous;
+   }
+
+   // The first outputs only cover part of the filter
+   if (this->outputs < this->order) {
+      this->outputs++;
+      if (this->outputs < this->order) {
+         return;
+      }
+   }
+
+   if (this->unread) {
+      this->missed++;
+   }
+
+   // Remove the gain while keeping the fractional bits, rounding to nearest
+   value = ((value << DECIMATOR_FRACTION_BITS) + this->gain/2) / this->gain;
+   this->latest.position = value;
+
+   // The filter is symmetric, so its output lines up with the middle of the
+   // order*(ratio - 1) sample periods it spans. This block spans ratio - 1 
+   // of them.
+   this->latest.timestamp = timestamp - (timestamp - this->blockTimestamp) * this->order / 2;
+   this->unread = true;
+}
+
+// read: gets the newest position given out, if it hasn't been read yet
+// Parameters: 
+// sample: the decimated sample to copy the position into
+// returns: true if there was a new position, false otherwise
+bool PositionDecimator::read(DecimatedSample& sample){
+   if (!this->unread) {
+      return false;
+   }
+
+   sample = this->latest;
+   this->unread = false;
+   return true;
+}
+
+// reset: empties the filter, so that the next position is given out once 
+//        order blocks of new samples have been taken in
+// Parameters: None
+// returns: nothing
+void PositionDecimator::reset(){
+   for(uint8_t stage = 0; stage < DECIMATOR_MAX_ORDER; stage++){
+      this->integrators[stage] = 0;
+      this->combs[stage] = 0;
+   }
+   this->phase = 0;
+   this->outputs = 0;
+   this->unread = false;
+}
+
+// getRatio: gets the number of samples taken in per position given out
+// Parameters: None
+// returns: the decimation ratio
+uint8_t PositionDecimator::getRatio(){
+   return this->ratio;
+}
+
+// getOrder: gets the number of integrator and comb stages
+// Parameters: None
+// returns: the order of the filter
+uint8_t PositionDecimator::getOrder(){
+   return this->order;
+}
+
+// getMissed: gets the number of positions that were replaced by a newer one
+//            before being read
+// Parameters: None
+// returns: the number of missed positions
+uint16_t PositionDecimator::getMissed(){
+   return this->missed;
+}
@@ -0,0 +1,113 @@
+/* position-decimator.h
+   Integer CIC decimation of encoder samples into a slower, finer position stream.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef POSITION_DECIMATOR_H
+#define POSITION_DECIMATOR_H
+
+#include <Arduino.h>
+
+// Most integrator and comb stages a decimator can have
+#define DECIMATOR_MAX_ORDER       3
+
+// Fractional bits of a decimated position. With the 26 bit positions of the
+// encoder this fills all 32 bits.
+#define DECIMATOR_FRACTION_BITS   6
+
+// DecimatedSample: one output of a decimator
+struct DecimatedSample
+{
+   uint32_t timestamp;     // micros() at the centre of the samples averaged
+   uint32_t position;      // Position in counts with DECIMATOR_FRACTION_BITS 
+                           // fractional bits
+};
+
+// PositionDecimator class: a cascaded integrator comb (CIC) filter that takes
+//                          in every encoder sample and gives out one position 
+//                          for every ratio samples. An order of 1 is a plain
+//                          boxcar average of each block of samples. Higher 
+//                          orders reject more of the noise above the output
+//                          rate, at the cost of a longer delay. Only additions
+//                          are done per sample. The integrators are 64 bits 
+//                          and allowed to wrap, since the combs take the wrap
+//                          back out, so no reference position is needed.
+class PositionDecimator {
+   private:
+      uint8_t ratio;
+      uint8_t order;
+
+      // Gain of the filter, ratio^order
+      uint32_t gain;
+
+      uint64_t integrators[DECIMATOR_MAX_ORDER];
+      uint64_t combs[DECIMATOR_MAX_ORDER];
+
+      // Samples taken in so far in the current block, and when the first of
+      // them was taken
+      uint8_t phase;
+      uint32_t blockTimestamp;
+
+      // Outputs worked out since the last reset, counting up to order. The 
+      // filter is only full once it reaches order.
+      uint8_t outputs;
+
+      DecimatedSample latest;
+      bool unread;
+
+      // Outputs replaced before they were read
+      uint16_t missed;
+
+   public:
+      PositionDecimator(uint8_t ratio, uint8_t order = 1);
+
+      void update(uint32_t timestamp, uint32_t rawPosition);
+
+      bool read(DecimatedSample& sample);
+
+      void reset();
+
+      uint8_t getRatio();
+
+      uint8_t getOrder();
+
+      uint16_t getMissed();
+};
+
+#endif
@@ -0,0 +1,240 @@
+/* position-observer.cpp
+   Fixed point tracking observer of encoder position, velocity and acceleration.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "position-observer.h"
+
+// PositionObserver constructor: sets up an observer that hasn't seen a 
+//                               sample yet
+// Parameters: 
+// bandwidth: how quickly the estimates follow the samples in Hz. The filter
+//            forgets old samples with a time constant of 1/(2*pi*bandwidth).
+// periodMicros: (optional parameter) the time between samples in 
+//               microseconds, or 0 to learn it from the first samples
+PositionObserver::PositionObserver(float bandwidth, uint32_t periodMicros){
+   this->bandwidth = bandwidth;
+   this->period = periodMicros;
+   this->restarts = 0;
+   this->reset();
+   if (this->period != 0) {
+      this->setGains();
+   }
+}
+
+// setGains: works out the gains of the fading memory filter for the 
+//           bandwidth and sample period. With theta = e^(-2*pi*bandwidth*T),
+//           alpha = 1 - theta^3, beta = 1.5*(1 - theta)^2*(1 + theta) and
+//           gamma = 0.5*(1 - theta)^3.
+// Parameters: None
+// returns: nothing
+void PositionObserver::setGains(){
+   float theta = exp(-2 * M_PI * this->bandwidth * this->period / 1000000.0);
+   float forget = 1 - theta;
+
+   this->alpha = (1 - theta*theta*theta) * 65536.0;
+   this->beta = 1.5 * forget*forget * (1 + theta) * 65536.0;
+   this->gamma2 = forget*forget*forget * 65536.0;
+}
+
+// restart: starts tracking again from a single sample, at rest
+// Parameters: 
+// timestamp: micros() when the sample was taken
+// rawPosition: the position of the sample in counts
+// returns: nothing
+void PositionObserver::restart(uint32_t timestamp, int32_t rawPosition){
+   this->position = (int64_t)rawPosition << 16;
+   this->velocity = 0;
+   this->acceleration = 0;
+   this->lastTimestamp = timestamp;
+   this->firstTimestamp = timestamp;
+   this->samples = 1;
+}
+
+// update: takes in a sample. Samples should arrive once per sample period,
+//         though some may be missing.
+// Parameters: 
+// timestamp: micros() when the sample was taken
+// rawPosition: the position of the sample in counts
+// returns: nothing
+void PositionObserver::update(uint32_t timestamp, uint32_t rawPosition){
+   int32_t measured = rawPosition;
+
+   if (this->samples == 0) {
+      this->restart(timestamp, measured);
+      return;
+   }
+
+   // Learn the sample period from the first samples if it wasn't given,
+   // following the samples meanwhile
+   if (this->period == 0) {
+      this->position = (int64_t)measured << 16;
+      this->lastTimestamp = timestamp;
+      if (++this->samples > OBSERVER_LEARN_SAMPLES) {
+         this->period = (timestamp - this->firstTimestamp + OBSERVER_LEARN_SAMPLES/2) 
+                        / OBSERVER_LEARN_SAMPLES;
+         this->setGains();
+         this->restart(timestamp, measured);
+      }
+      return;
+   }
+
+   // Work out how many periods have passed, to the nearest period, by 
+   // subtracting since this is almost always just one
+   uint32_t elapsed = timestamp - this->lastTimestamp + this->period/2;
+   uint8_t steps = 0;
+   while (elapsed >= this->period && steps <= OBSERVER_MAX_GAP) {
+      elapsed -= this->period;
+      steps++;
+   }
+
+   if (steps == 0) {
+      // The same sample as the last one
+      return;
+   }
+   if (steps > OBSERVER_MAX_GAP) {
+      this->restarts++;
+      this->restart(timestamp, measured);
+      return;
+   }
+   this->lastTimestamp = timestamp;
+
+   // Predict forward to this sample
+   for(uint8_t step = 0; step < steps; step++){
+      this->position += this->velocity + (this->acceleration >> 1);
+      this->velocity += this->acceleration;
+   }
+
+   // Correct by the difference from the prediction, in whole counts
+   int32_t residual = measured - (int32_t)((this->position + 0x8000) >> 16);
+   if (residual > OBSERVER_MAX_RESIDUAL || residual < -OBSERVER_MAX_RESIDUAL) {
+      this->restarts++;
+      this->restart(timestamp, measured);
+      return;
+   }
+
+   this->position += this->alpha * residual;
+   this->velocity += this->beta * residual;
+   this->acceleration += this->gamma2 * residual;
+
+   if (this->samples < OBSERVER_LEARN_SAMPLES) {
+      this->samples++;
+   }
+}
+
+// reset: forgets every sample, so that tracking starts again from the next
+// Parameters: None
+// returns: nothing
+void PositionObserver::reset(){
+   this->position = 0;
+   this->velocity = 0;
+   this->acceleration = 0;
+   this->lastTimestamp = 0;
+   this->firstTimestamp = 0;
+   this->samples = 0;
+}
+
+// setPeriod: changes the sample period, such as when the rate of the MB4's
+//            cycles is changed. The velocity and acceleration are rescaled 
+//            to the new period, so tracking carries on across the change.
+// Parameters: 
+// periodMicros: the new time between samples in microseconds
+// returns: nothing
+void PositionObserver::setPeriod(uint32_t periodMicros){
+   if (periodMicros == 0 || periodMicros == this->period) {
+      return;
+   }
+
+   if (this->period != 0) {
+      this->velocity = (int64_t)this->velocity * periodMicros / this->period;
+      this->acceleration = (int64_t)this->acceleration * periodMicros / this->period 
+                           * periodMicros / this->period;
+   }
+   this->period = periodMicros;
+   this->setGains();
+}
+
+// isTracking: checks if the estimates can be used. The observer needs the 
+//             sample period and a few samples since it last restarted.
+// Parameters: None
+// returns: true if the observer is tracking
+bool PositionObserver::isTracking(){
+   return this->period != 0 && this->samples >= OBSERVER_LEARN_SAMPLES;
+}
+
+// getPeriod: gets the sample period
+// Parameters: None
+// returns: the period in microseconds, or 0 if it hasn't been learned yet
+uint32_t PositionObserver::getPeriod(){
+   return this->period;
+}
+
+// getRestarts: gets the number of times tracking was lost, from a jump in 
+//              position or a long gap in the samples
+// Parameters: None
+// returns: the number of restarts
+uint16_t PositionObserver::getRestarts(){
+   return this->restarts;
+}
+
+// getState: gets the estimates, converted to counts and seconds. This takes a
+//           few 64 bit divisions, so is meant to be called at the rate the 
+//           estimates are used rather than for every sample.
+// Parameters: None
+// returns: the estimates as of the last sample
+ObserverState PositionObserver::getState(){
+   ObserverState state;
+   state.timestamp = this->lastTimestamp;
+   state.position = (int32_t)((this->position + 0x8000) >> 16);
+
+   if (this->period == 0) {
+      state.velocity = 0;
+      state.acceleration = 0;
+      return state;
+   }
+
+   // Per period to per second, keeping within 64 bits
+   int64_t perSecond = (int64_t)this->velocity * 1000000 / this->period;
+   state.velocity = (int32_t)(perSecond >> 16);
+
+   perSecond = ((int64_t)this->acceleration * 1000000 / this->period) >> 16;
+   state.acceleration = (int32_t)(perSecond * 1000000 / this->period);
+
+   return state;
+}
@@ -0,0 +1,126 @@
+/* position-observer.h
+   Fixed point tracking observer of encoder position, velocity and acceleration.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef POSITION_OBSERVER_H
+#define POSITION_OBSERVER_H
+
+#include <Arduino.h>
+
+// Largest difference between a sample and the predicted position, in counts,
+// before the observer gives up tracking and restarts from the sample
+#define OBSERVER_MAX_RESIDUAL   16384
+
+// Longest gap between samples, in sample periods, before the observer 
+// restarts instead of predicting across it
+#define OBSERVER_MAX_GAP        16
+
+// Number of samples used to learn the sample period when it isn't given. 
+// This must be a power of two.
+#define OBSERVER_LEARN_SAMPLES  16
+
+// ObserverState: the estimates of the observer, all as of the same sample
+struct ObserverState
+{
+   uint32_t timestamp;     // micros() of the last sample taken in
+   int32_t position;       // Position in counts
+   int32_t velocity;       // Velocity in counts per second
+   int32_t acceleration;   // Acceleration in counts per second^2
+};
+
+// PositionObserver class: an alpha-beta-gamma tracking filter that estimates 
+//                         position, velocity and acceleration from raw encoder 
+//                         samples taken at a steady rate, such as those 
+//                         captured on the end of transmission interrupt. The 
+//                         gains are those of a fading memory filter, set by a
+//                         single bandwidth. The state is kept in 16.16 fixed 
+//                         point per sample period, so each sample only costs 
+//                         a few 32 bit multiplies. Missed samples are 
+//                         predicted across using the timestamps.
+class PositionObserver {
+   private:
+      float bandwidth;
+
+      // Sample period in microseconds, 0 while it is being learned
+      uint32_t period;
+
+      // Gains alpha, beta and 2*gamma in 16.16 fixed point
+      int32_t alpha;
+      int32_t beta;
+      int32_t gamma2;
+
+      // Position in counts, velocity in counts per period and acceleration 
+      // in counts per period^2, all in 16.16 fixed point
+      int64_t position;
+      int32_t velocity;
+      int32_t acceleration;
+
+      uint32_t lastTimestamp;
+
+      // Samples taken in since the last restart, counting up to 
+      // OBSERVER_LEARN_SAMPLES, and when the first of them was taken
+      uint8_t samples;
+      uint32_t firstTimestamp;
+
+      uint16_t restarts;
+
+      void setGains();
+
+      void restart(uint32_t timestamp, int32_t rawPosition);
+
+   public:
+      PositionObserver(float bandwidth, uint32_t periodMicros = 0);
+
+      void update(uint32_t timestamp, uint32_t rawPosition);
+
+      void reset();
+
+      void setPeriod(uint32_t periodMicros);
+
+      bool isTracking();
+
+      uint32_t getPeriod();
+
+      uint16_t getRestarts();
+
+      ObserverState getState();
+};
+
+#endif
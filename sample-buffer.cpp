@@ -0,0 +1,134 @@
+/* sample-buffer.cpp
+   Source code for a ring buffer of timestamped encoder samples.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Include the header file which has all of the prototypes of the functions
+// contained in this source file.
+#include "sample-buffer.h"
+
+// Keeps the compiler from moving memory accesses across this point, so that
+// a sample is completely written or read before the counter is changed
+#define MEMORY_BARRIER()   __asm__ __volatile__("" ::: "memory")
+
+// SampleBuffer: Constructor for the SampleBuffer class, starts out empty
+// Parameters: none
+SampleBuffer::SampleBuffer(){
+   this->writeCount = 0;
+   this->readCount = 0;
+   this->overruns = 0;
+}
+
+// push: adds a sample to the buffer. Only the producer may call this.
+// Parameters:
+// timestamp: the time in microseconds the sample was taken
+// rawPosition: the raw position in bits
+// status: the status bits of the sample
+// returns: true if the sample was added, false if the buffer was full
+bool SampleBuffer::push(uint32_t timestamp, uint32_t rawPosition, uint8_t status){
+   uint8_t write = this->writeCount;
+
+   // The counters wrap together, so the difference is always the fill level
+   if ((uint8_t)(write - this->readCount) >= SAMPLE_BUFFER_SIZE) {
+      this->overruns++;
+      return false;
+   }
+
+   Sample& sample = this->samples[write & (SAMPLE_BUFFER_SIZE - 1)];
+   sample.timestamp = timestamp;
+   sample.rawPosition = rawPosition;
+   sample.status = status;
+
+   // Only publish the sample once it has been completely written
+   MEMORY_BARRIER();
+   this->writeCount = write + 1;
+
+   return true;
+}
+
+// pop: takes the oldest sample out of the buffer. Only the consumer may call
+//      this.
+// Parameters:
+// sample: the sample to copy the oldest sample into
+// returns: true if a sample was copied, false if the buffer was empty
+bool SampleBuffer::pop(Sample& sample){
+   uint8_t read = this->readCount;
+
+   if (read == this->writeCount) {
+      return false;
+   }
+
+   sample = this->samples[read & (SAMPLE_BUFFER_SIZE - 1)];
+
+   // Only free the slot once the sample has been completely read
+   MEMORY_BARRIER();
+   this->readCount = read + 1;
+
+   return true;
+}
+
+// available: gets the number of samples waiting to be read
+// Parameters: none
+// returns: the number of samples in the buffer
+uint8_t SampleBuffer::available(){
+   return this->writeCount - this->readCount;
+}
+
+// getOverruns: gets the number of samples dropped because the buffer was full.
+//              The count is two bytes, so interrupts are held off just long 
+//              enough to read it in one piece.
+// Parameters: none
+// returns: the number of samples dropped
+uint16_t SampleBuffer::getOverruns(){
+   uint8_t oldSREG = SREG;
+   cli();
+   uint16_t count = this->overruns;
+   SREG = oldSREG;
+   return count;
+}
+
+// clear: empties the buffer and resets the overrun count. This should only be 
+//        called while the producer is stopped.
+// Parameters: none
+// returns: nothing
+void SampleBuffer::clear(){
+   this->readCount = this->writeCount;
+   this->overruns = 0;
+}
@@ -0,0 +1,133 @@
+/* sample-buffer.h
+   Class for passing timestamped encoder samples from an interrupt to loop().
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SAMPLE_BUFFER_H
+#define SAMPLE_BUFFER_H
+
+#include <Arduino.h>
+
+// Number of samples the buffer can hold. This must be a power of two no 
+// larger than 128 so that the read and write counters can wrap freely.
+#ifndef SAMPLE_BUFFER_SIZE
+#define SAMPLE_BUFFER_SIZE   32
+#endif
+
+#if (SAMPLE_BUFFER_SIZE & (SAMPLE_BUFFER_SIZE - 1)) != 0 || SAMPLE_BUFFER_SIZE > 128
+#error "SAMPLE_BUFFER_SIZE must be a power of two no larger than 128"
+#endif
+
+// Flag or'd into the status of a sample when the MB4 reported a bad CRC
+#define SAMPLE_INVALID_CRC   0x80
+
+// Sample: a single encoder reading along with the time it was taken
+struct Sample
+{
+   uint32_t timestamp;     // micros() when the sample was captured
+   uint32_t rawPosition;   // Raw position in bits
+   uint8_t status;         // Encoder status bits (bit 1:0) and SAMPLE_INVALID_CRC
+};
+
+// BurstBuffer: caller provided arrays filled by MB4Driver::captureBurst(). 
+//              The samples are kept as separate arrays rather than an array 
+//              of Sample so that no padding is wasted and each array can be 
+//              placed wherever there is room for it. Each array must hold at
+//              least capacity entries.
+struct BurstBuffer
+{
+   uint32_t* timestamps;   // micros() when each sample was captured
+   uint32_t* positions;    // Raw position of each sample in bits
+   uint8_t* status;        // Encoder status bits (bit 1:0) and SAMPLE_INVALID_CRC
+   uint16_t capacity;      // Number of entries in each array
+   uint16_t count;         // Number of samples captured by the last burst
+};
+
+// The binary form written by MB4Driver::dumpBurst(). Every value is little 
+// endian. The header is BURST_MAGIC, BURST_VERSION, the number of records 
+// (2 bytes) and the timestamp of the first sample (4 bytes). Each record is 
+// the time since the previous sample in us (2 bytes, BURST_MAX_DELTA if it 
+// was longer) followed by the raw position with the status packed above it 
+// (4 bytes). The dump ends with the 16 bit sum of every byte after the magic.
+#define BURST_MAGIC          "MB4B"
+#define BURST_MAGIC_SIZE     4
+#define BURST_VERSION        1
+#define BURST_HEADER_SIZE    (BURST_MAGIC_SIZE + 7)
+#define BURST_RECORD_SIZE    6
+#define BURST_MAX_DELTA      0xFFFF
+#define BURST_POSITION_MASK  0x03FFFFFFUL  // 26 bit raw position
+#define BURST_STATUS_SHIFT   26            // Encoder status bits 27:26
+#define BURST_INVALID_CRC    (1UL << 28)
+
+// SampleBuffer class: a fixed size ring buffer of samples with a single 
+//                     producer (usually an interrupt) and a single consumer 
+//                     (usually loop()). Neither side needs to disable 
+//                     interrupts, since the producer only ever changes the 
+//                     write counter and the consumer only ever changes the read
+//                     counter, and each counter is a single byte. When the 
+//                     buffer is full new samples are dropped and counted as 
+//                     overruns, leaving the samples already queued intact.
+class SampleBuffer {
+   private:
+      Sample samples[SAMPLE_BUFFER_SIZE];
+
+      // Free running counters of samples written and read. Only the low bits
+      // are used to index into samples.
+      volatile uint8_t writeCount;
+      volatile uint8_t readCount;
+
+      // Number of samples dropped because the buffer was full
+      volatile uint16_t overruns;
+
+   public:
+      SampleBuffer();
+
+      bool push(uint32_t timestamp, uint32_t rawPosition, uint8_t status);
+
+      bool pop(Sample& sample);
+
+      uint8_t available();
+
+      uint16_t getOverruns();
+
+      void clear();
+};
+
+#endif
@@ -0,0 +1,180 @@
+/* Arduino.h
+   Host stand-in for the parts of the Arduino core used by the MB4Driver.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// This header takes the place of the real Arduino.h when the driver is built
+// for the host against the MB4 simulator (see mb4-sim.h). Only what the 
+// driver and its helpers use is provided. Time is simulated: it only moves 
+// forward when the code does something that takes time on an AVR, so runs are
+// repeatable and nothing ever waits in real time.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define DEC             10
+#define HEX             16
+#define BIN             2
+
+#define NOT_AN_INTERRUPT   -1
+#define digitalPinToInterrupt(pin)   ((pin) == 2 ? 0 : ((pin) == 3 ? 1 : NOT_AN_INTERRUPT))
+
+// Program memory is ordinary memory on the host
+#define PROGMEM
+#define pgm_read_byte(address)    (*(const uint8_t*)(address))
+#define pgm_read_word(address)    (*(const uint16_t*)(address))
+#define memcpy_P                  memcpy
+#define F(string)                 (string)
+
+// Approximate time taken by the Arduino core on a 16 MHz AVR, in nanoseconds.
+// These are charged to the simulated clock so that timings measured against 
+// the simulator come out close to those on the real board.
+#define SIM_DIGITAL_WRITE_NS   3000
+#define SIM_MICROS_NS          1000
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void attachInterrupt(uint8_t interruptNumber, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interruptNumber);
+void noInterrupts();
+void interrupts();
+
+// SimSREG: stands in for the AVR status register. Only the global interrupt
+//          enable (bit 7) is kept, so that saving SREG, disabling interrupts
+//          and writing SREG back behaves as it does on the AVR.
+struct SimSREG
+{
+   operator uint8_t() const;
+   SimSREG& operator=(uint8_t value);
+};
+extern SimSREG SREG;
+
+#define cli()   noInterrupts()
+#define sei()   interrupts()
+
+// Print: the printing methods of Serial, written to standard output. Only 
+//        write() can be overridden, the print methods always go to standard
+//        output.
+class Print {
+   public:
+      virtual ~Print() {}
+
+      virtual size_t write(uint8_t data);
+      virtual size_t write(const uint8_t* data, size_t size);
+
+      size_t print(const char* text);
+      size_t print(char character);
+      size_t print(unsigned char number, int base = DEC);
+      size_t print(int number, int base = DEC);
+      size_t print(unsigned int number, int base = DEC);
+      size_t print(long number, int base = DEC);
+      size_t print(unsigned long number, int base = DEC);
+      size_t print(double number, int digits = 2);
+
+      size_t println();
+      size_t println(const char* text);
+      size_t println(char character);
+      size_t println(unsigned char number, int base = DEC);
+      size_t println(int number, int base = DEC);
+      size_t println(unsigned int number, int base = DEC);
+      size_t println(long number, int base = DEC);
+      size_t println(unsigned long number, int base = DEC);
+      size_t println(double number, int digits = 2);
+};
+
+class HardwareSerial : public Print {
+   public:
+      void begin(unsigned long baud);
+      operator bool();
+};
+extern HardwareSerial Serial;
+
+// Functions for the simulator to drive the stand-in core. These have no 
+// counterpart on the Arduino.
+
+// SimPinListener: something attached to a pin, told when the pin is written
+class SimPinListener {
+   public:
+      virtual ~SimPinListener() {}
+      virtual void pinWritten(uint8_t pin, uint8_t value) = 0;
+};
+
+// SimTimeListener: something that runs on the simulated clock, told every 
+//                  time the clock moves forward
+class SimTimeListener {
+   public:
+      virtual ~SimTimeListener() {}
+      virtual void timeChanged(uint64_t nanos) = 0;
+};
+
+void simAttachPin(uint8_t pin, SimPinListener* listener);
+void simAddTimeListener(SimTimeListener* listener);
+void simRemoveTimeListener(SimTimeListener* listener);
+
+uint64_t simNanos();
+void simAdvance(uint64_t nanos);
+
+void simTriggerPin(uint8_t pin);
+
+#endif
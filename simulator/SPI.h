@@ -0,0 +1,115 @@
+/* SPI.h
+   Host stand-in for the Arduino SPI library, connected to simulated devices.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SIM_SPI_H
+#define SIM_SPI_H
+
+#include <Arduino.h>
+
+#define MSBFIRST    1
+#define LSBFIRST    0
+#define SPI_MODE0   0x00
+#define SPI_MODE1   0x04
+#define SPI_MODE2   0x08
+#define SPI_MODE3   0x0C
+
+// Approximate time taken by SPI.transfer() around each byte on a 16 MHz AVR,
+// in nanoseconds, on top of the 8 clocks of the byte itself, and by 
+// SPI.beginTransaction() and SPI.endTransaction() together
+#define SIM_SPI_BYTE_OVERHEAD_NS   500
+#define SIM_SPI_TRANSACTION_NS     1500
+
+// SimSPIDevice: a simulated device on the SPI bus. Every byte transferred is
+//               given to the device whose chip select is low.
+class SimSPIDevice {
+   public:
+      virtual ~SimSPIDevice() {}
+
+      // Called with each byte sent and the SPI clock it was sent at. Returns
+      // the byte that the device sends back.
+      virtual uint8_t transfer(uint8_t data, uint32_t clock) = 0;
+
+      // Whether the device is selected (its chip select is low)
+      virtual bool isSelected() = 0;
+};
+
+// SPISettings: the clock, bit order and mode of a transaction
+class SPISettings {
+   public:
+      SPISettings(uint32_t clock = 4000000, uint8_t bitOrder = MSBFIRST, 
+                  uint8_t dataMode = SPI_MODE0)
+         : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+
+      uint32_t clock;
+      uint8_t bitOrder;
+      uint8_t dataMode;
+};
+
+// SPIClass: the SPI bus. Each byte takes the time of 8 clocks of the current
+//           transaction on the simulated clock.
+class SPIClass {
+   public:
+      static void begin();
+
+      static void end();
+
+      static void beginTransaction(SPISettings settings);
+
+      static void endTransaction();
+
+      static uint8_t transfer(uint8_t data);
+
+      static void transfer(void* buffer, size_t count);
+
+      static void usingInterrupt(uint8_t interruptNumber);
+
+      static void notUsingInterrupt(uint8_t interruptNumber);
+
+      // Add and remove simulated devices on the bus. These have no 
+      // counterpart on the Arduino.
+      static void simAddDevice(SimSPIDevice* device);
+
+      static void simRemoveDevice(SimSPIDevice* device);
+};
+
+extern SPIClass SPI;
+
+#endif
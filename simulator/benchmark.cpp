@@ -0,0 +1,274 @@
+/* benchmark.cpp
+   Benchmarks the read path of the MB4Driver against the MB4 simulator, on the host.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mb4-sim.h"
+#include "mb4-driver.h"
+
+#define SELECT_PIN   10
+
+// Number of positions read before measuring, and measured, for each case
+#define WARMUP_READS      16
+#define MEASURED_READS    2000
+
+// Number of random frames the CRC table is checked against the bit by bit 
+// CRC, and the number of blocks of MAX_SLAVES frames its cost is timed over
+#define CRC_CHECKED_FRAMES   1000000
+#define CRC_TIMED_BLOCKS     200000
+
+// The ways of reading a position that are benchmarked
+enum readMode
+{
+   mode_register,       // A register at a time, as the driver first did
+   mode_burst,          // getRawPosition() with burst reads
+   mode_fast,           // getRawPosition() with READ_DATA0
+   mode_burst_crc,      // Burst reads with the CRC checked in software
+   mode_fast_crc,       // READ_DATA0 with the CRC checked in software
+   num_modes
+};
+
+static const char* modeNames[num_modes] = {
+   "register", "burst", "fast", "burst+swcrc", "fast+swcrc"
+};
+
+// SPI clocks each mode is benchmarked at in Hz
+static const uint32_t clocks[] = {1000000, 2000000, 4000000, 8000000};
+
+// readByRegister: reads a position a register at a time, the way the driver
+//                 did before burst reads, so that the gains stay measurable
+// Parameters: 
+// driver: the driver to read with
+// returns: the raw position
+static uint32_t readByRegister(MB4Driver& driver){
+   driver.writeInstruction(driver.readRegister(INSTR, 1) | HOLDBANK);
+
+   uint32_t reading = 0;
+   for(uint8_t index = 0; index < 4; index++){
+      reading += driver.readRegister(SCDATA1 + index, 1) << (index*8);
+   }
+   driver.readRegister(SCDATA1, 1);
+   driver.readRegister(SVALID, 1);
+
+   driver.writeInstruction(driver.readRegister(INSTR, 1) & ~HOLDBANK);
+   return reading >> 2;
+}
+
+// readPosition: reads a single position in the given mode
+// Parameters: 
+// driver: the driver to read with
+// mode: the mode to read in
+// returns: nothing
+static void readPosition(MB4Driver& driver, uint8_t mode){
+   if (mode == mode_register) {
+      readByRegister(driver);
+   }
+   else {
+      driver.getRawPosition();
+   }
+}
+
+// checkCRCTable: checks the driver's table driven CRC against the bit by bit 
+//                CRC of the simulated encoder: every byte, every pair of 
+//                bytes, every frame with a single bit set and 
+//                CRC_CHECKED_FRAMES random frames
+// Parameters: none
+// returns: the number of mismatches
+static uint32_t checkCRCTable(){
+   uint32_t mismatches = 0;
+   for(uint32_t value = 0; value < 0x10000; value++){
+      uint8_t bytes[2] = {(uint8_t)(value >> 8), (uint8_t)value};
+      mismatches += bissCRC6(bytes, 2) != EncoderModel::bitwiseCRC6(value, 16);
+      if (value < 0x100) {
+         mismatches += bissCRC6(bytes + 1, 1) != EncoderModel::bitwiseCRC6(value, 8);
+      }
+   }
+
+   for(uint8_t bit = 0; bit < BISS_CRC6_DATA_BITS; bit++){
+      uint32_t frameData = 1UL << bit;
+      mismatches += bissCRC6(frameData) != 
+                    EncoderModel::bitwiseCRC6(frameData, BISS_CRC6_DATA_BITS);
+   }
+
+   srand(1);
+   for(uint32_t frame = 0; frame < CRC_CHECKED_FRAMES; frame++){
+      uint32_t frameData = (((uint32_t)rand() << 16) ^ (uint32_t)rand()) & 
+                           ((1UL << BISS_CRC6_DATA_BITS) - 1);
+      mismatches += bissCRC6(frameData) != 
+                    EncoderModel::bitwiseCRC6(frameData, BISS_CRC6_DATA_BITS);
+   }
+   return mismatches;
+}
+
+// timeCRCs: times checkFrameCRCs() over blocks of MAX_SLAVES frames on the 
+//           host's own clock, since the simulated clock doesn't charge for 
+//           computation
+// Parameters: 
+// driver: the driver to check the frames with
+// returns: the time to check one frame in nanoseconds
+static double timeCRCs(MB4Driver& driver){
+   MB4Driver::PositionFrame frames[MAX_SLAVES];
+   for(uint8_t slave = 0; slave < MAX_SLAVES; slave++){
+      frames[slave].rawPosition = 1000000UL + slave*12345UL;
+      frames[slave].encoderStatus = 0;
+      frames[slave].crc = ~EncoderModel::bitwiseCRC6(frames[slave].rawPosition << 2, 
+                                                     BISS_CRC6_DATA_BITS) & 0x3F;
+   }
+
+   struct timespec start;
+   struct timespec end;
+   uint32_t errors = 0;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for(uint32_t block = 0; block < CRC_TIMED_BLOCKS; block++){
+      // Corrupt a frame of every other block so the checks can't be hoisted
+      // out of the loop
+      MB4Driver::PositionFrame& frame = frames[block % MAX_SLAVES];
+      frame.rawPosition ^= block & 1;
+      errors += driver.checkFrameCRCs(frames, MAX_SLAVES);
+      frame.rawPosition ^= block & 1;
+   }
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   // Half of the blocks have a flipped bit in one frame
+   if (errors != CRC_TIMED_BLOCKS / 2) {
+      printf("crc timing: %lu frames failed, expected %lu\n", (unsigned long)errors,
+             (unsigned long)(CRC_TIMED_BLOCKS / 2));
+   }
+
+   double nanos = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+   return nanos / ((double)CRC_TIMED_BLOCKS * MAX_SLAVES);
+}
+
+static int compareLatency(const void* a, const void* b){
+   uint64_t first = *(const uint64_t*)a;
+   uint64_t second = *(const uint64_t*)b;
+   return (first > second) - (first < second);
+}
+
+// Runs every mode at every clock and prints a table, followed by one 
+// comma separated line per case starting with "BENCH" and the label given as
+// the first argument (a commit hash, say), for keeping a history.
+int main(int argc, char** argv){
+   const char* label = argc > 1 ? argv[1] : "-";
+
+   EncoderModel encoder;
+   encoder.setMotion(1000000, 40000);
+
+   MB4Simulator simulator(SELECT_PIN);
+   simulator.attachEncoder(0, &encoder);
+
+   MB4Driver driver(SELECT_PIN, 0);
+   driver.begin();
+   while (!driver.poll()) {
+      if (driver.hasFailed()) {
+         printf("start up failed\n");
+         return 1;
+      }
+   }
+
+   static uint64_t latencies[MEASURED_READS];
+   double meanLatency[num_modes][sizeof(clocks) / sizeof(clocks[0])];
+   char lines[num_modes * sizeof(clocks) / sizeof(clocks[0])][160];
+   uint8_t numLines = 0;
+
+   printf("%-12s %8s %12s %9s %9s %8s %8s\n", "mode", "clock", "samples/s", 
+          "p50(us)", "p99(us)", "bytes", "trans");
+
+   for(uint8_t mode = 0; mode < num_modes; mode++){
+      driver.setFastAccess(mode == mode_fast || mode == mode_fast_crc);
+      driver.setSoftwareCRC(mode == mode_burst_crc || mode == mode_fast_crc);
+
+      for(uint8_t index = 0; index < sizeof(clocks) / sizeof(clocks[0]); index++){
+         driver.setSPIClock(clocks[index]);
+
+         for(uint16_t read = 0; read < WARMUP_READS; read++){
+            readPosition(driver, mode);
+         }
+
+         uint32_t startTransactions = simulator.getTransactions();
+         uint32_t startBytes = simulator.getBytes();
+         uint64_t total = 0;
+         for(uint16_t read = 0; read < MEASURED_READS; read++){
+            uint64_t start = simNanos();
+            readPosition(driver, mode);
+            latencies[read] = simNanos() - start;
+            total += latencies[read];
+         }
+
+         qsort(latencies, MEASURED_READS, sizeof(latencies[0]), compareLatency);
+         double rate = MEASURED_READS / (total / 1e9);
+         meanLatency[mode][index] = total / 1e3 / MEASURED_READS;
+         double p50 = latencies[MEASURED_READS / 2] / 1e3;
+         double p99 = latencies[MEASURED_READS * 99 / 100] / 1e3;
+         double bytes = (double)(simulator.getBytes() - startBytes) / MEASURED_READS;
+         double transactions = (double)(simulator.getTransactions() - startTransactions) 
+                               / MEASURED_READS;
+
+         printf("%-12s %8lu %12.0f %9.1f %9.1f %8.1f %8.1f\n", modeNames[mode], 
+                (unsigned long)clocks[index], rate, p50, p99, bytes, transactions);
+         snprintf(lines[numLines++], sizeof(lines[0]), "BENCH,%s,%s,%lu,%.0f,%.1f,%.1f,%.1f,%.1f",
+                  label, modeNames[mode], (unsigned long)clocks[index], rate, p50, p99, 
+                  bytes, transactions);
+      }
+   }
+
+   // The software CRC check against the SVALID read of the hardware check
+   uint32_t crcMismatches = checkCRCTable();
+   printf("\ncrc table: %s, %lu mismatches with the bit by bit CRC\n", 
+          crcMismatches == 0 ? "passed" : "FAILED", (unsigned long)crcMismatches);
+   double crcNanos = timeCRCs(driver);
+   printf("crc check: %.1f ns per frame on this host (not the Arduino)\n", crcNanos);
+   printf("%-12s %8s %14s\n", "crc", "clock", "bus saved(us)");
+   for(uint8_t index = 0; index < sizeof(clocks) / sizeof(clocks[0]); index++){
+      double saved = meanLatency[mode_burst][index] - meanLatency[mode_burst_crc][index];
+      printf("%-12s %8lu %14.1f\n", "burst", (unsigned long)clocks[index], saved);
+   }
+
+   printf("\n");
+   for(uint8_t line = 0; line < numLines; line++){
+      printf("%s\n", lines[line]);
+   }
+   printf("BENCH,%s,crc,%.1f,%lu\n", label, crcNanos, (unsigned long)crcMismatches);
+
+   return crcMismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,696 @@
+/* mb4-sim.cpp
+   Register level simulation of an IC-MB4 with BiSS C encoders, for the host.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "mb4-sim.h"
+
+// EncoderModel constructor: a stationary encoder at 0 with no faults
+// Parameters:
+// seed: (optional parameter) the seed of the random faults, must not be 0
+EncoderModel::EncoderModel(uint32_t seed){
+   this->setMotion(0, 0);
+   this->status = 0;
+   this->crcErrorRate = 0;
+   this->dropRate = 0;
+   this->injectedCRCErrors = 0;
+   this->injectedDrops = 0;
+   this->randomState = seed ? seed : 1;
+
+   // The identification registers of the BiSS standard
+   memset(this->registers, 0, sizeof(this->registers));
+   for(uint8_t index = 0; index < BISS_SERIAL_NUMBER_SIZE; index++){
+      this->registers[BISS_SERIAL_NUMBER + index] = this->random();
+   }
+   memcpy(this->registers + BISS_DEVICE_ID, "LMA10 ", BISS_DEVICE_ID_SIZE);
+   memcpy(this->registers + BISS_MANUFACTURER_ID, "RS", BISS_MANUFACTURER_ID_SIZE);
+}
+
+// random: xorshift32 random number generator
+// Parameters: None
+// returns: the next random number
+uint32_t EncoderModel::random(){
+   uint32_t x = this->randomState;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   this->randomState = x;
+   return x;
+}
+
+// chance: draws a random event
+// Parameters: 
+// probability: the chance of the event, 0 to 1
+// returns: true if the event happened
+bool EncoderModel::chance(double probability){
+   return probability > 0 && (this->random() >> 8) < probability * (1UL << 24);
+}
+
+// setMotion: sets the motion profile of the encoder, in counts
+// Parameters: 
+// start: the position at time 0
+// velocity: the steady velocity in counts per second
+// amplitude: (optional parameter) the amplitude of a sine added on top
+// period: (optional parameter) the period of the sine in seconds
+// returns: nothing
+void EncoderModel::setMotion(double start, double velocity, double amplitude, 
+                             double period){
+   this->start = start;
+   this->velocity = velocity;
+   this->amplitude = amplitude;
+   this->period = period;
+}
+
+// setStatus: sets the status bits sent with every frame
+// Parameters: 
+// status: the error and warning bits (bit 1:0)
+// returns: nothing
+void EncoderModel::setStatus(uint8_t status){
+   this->status = status & 0b00000011;
+}
+
+// setCRCErrorRate: sets the chance of each frame being corrupted on the line
+// Parameters: 
+// probability: the chance, 0 to 1
+// returns: nothing
+void EncoderModel::setCRCErrorRate(double probability){
+   this->crcErrorRate = probability;
+}
+
+// setDropRate: sets the chance of the encoder not answering a cycle
+// Parameters: 
+// probability: the chance, 0 to 1
+// returns: nothing
+void EncoderModel::setDropRate(double probability){
+   this->dropRate = probability;
+}
+
+// injectCRCErrors: corrupts the next frames sent
+// Parameters: 
+// count: the number of frames to corrupt
+// returns: nothing
+void EncoderModel::injectCRCErrors(uint16_t count){
+   this->injectedCRCErrors = count;
+}
+
+// injectDrops: leaves the next cycles unanswered
+// Parameters: 
+// count: the number of cycles not to answer
+// returns: nothing
+void EncoderModel::injectDrops(uint16_t count){
+   this->injectedDrops = count;
+}
+
+// getPosition: gets the true position of the encoder
+// Parameters: 
+// nanos: the simulated time in nanoseconds
+// returns: the position in counts, wrapped to the 26 bits sent
+uint32_t EncoderModel::getPosition(uint64_t nanos){
+   double seconds = nanos / 1e9;
+   double position = this->start + this->velocity * seconds 
+                     + this->amplitude * sin(2 * M_PI * seconds / this->period);
+   return (uint32_t)(int64_t)floor(position + 0.5) & SIM_POSITION_MASK;
+}
+
+// sendFrame: answers a cycle started at the given time
+// Parameters: 
+// nanos: the simulated time the cycle started at
+// data: set to the position and status bits as received by the MB4
+// crc: set to the inverted CRC6 as received by the MB4
+// returns: false if the encoder did not answer
+bool EncoderModel::sendFrame(uint64_t nanos, uint32_t& data, uint8_t& crc){
+   if (this->injectedDrops > 0) {
+      this->injectedDrops--;
+      return false;
+   }
+   if (this->chance(this->dropRate)) {
+      return false;
+   }
+
+   data = (this->getPosition(nanos) << 2) | this->status;
+   crc = ~bitwiseCRC6(data, BISS_CRC6_DATA_BITS) & 0x3F;
+
+   // A bit flipped on the line after the CRC was worked out
+   if (this->injectedCRCErrors > 0 || this->chance(this->crcErrorRate)) {
+      if (this->injectedCRCErrors > 0) {
+         this->injectedCRCErrors--;
+      }
+      data ^= 1UL << (this->random() % BISS_CRC6_DATA_BITS);
+   }
+
+   return true;
+}
+
+// bitwiseCRC6: works out the BiSS CRC6 (x^6 + x + 1) one bit at a time, the
+//              way the encoder and the MB4 shift it. This is kept apart from
+//              the driver's table driven bissCRC6(), so that the simulator 
+//              checks the driver rather than agreeing with it by 
+//              construction.
+// Parameters: 
+// data: the bits to work out the CRC of, right aligned
+// numBits: the number of bits, sent most significant first
+// returns: the 6 bit CRC, before the inversion that BiSS applies when sending
+uint8_t EncoderModel::bitwiseCRC6(uint32_t data, uint8_t numBits){
+   uint8_t crc = 0;
+   for(uint8_t bit = numBits; bit > 0; bit--){
+      uint8_t feedback = ((crc >> 5) ^ (data >> (bit - 1))) & 1;
+      crc = (crc << 1) & 0x3F;
+      if (feedback) {
+         crc ^= 0x03;   // x + 1, the x^6 term is the bit shifted out
+      }
+   }
+   return crc;
+}
+
+// readBissRegister: reads a register of the encoder, as register 
+//                   communication does
+// Parameters: 
+// registerAddress: the register to read
+// returns: the value of the register
+uint8_t EncoderModel::readBissRegister(uint8_t registerAddress){
+   return this->registers[registerAddress % BISS_REGISTERS];
+}
+
+// writeBissRegister: writes a register of the encoder, as register 
+//                    communication does. Only the first 
+//                    SIM_WRITABLE_REGISTERS registers take writes.
+// Parameters: 
+// registerAddress: the register to write
+// data: the value to write
+// returns: nothing
+void EncoderModel::writeBissRegister(uint8_t registerAddress, uint8_t data){
+   if (registerAddress < SIM_WRITABLE_REGISTERS) {
+      this->registers[registerAddress] = data;
+   }
+}
+
+// setBissRegister: sets any register of the encoder, read only or not
+// Parameters: 
+// registerAddress: the register to set
+// data: the value to set
+// returns: nothing
+void EncoderModel::setBissRegister(uint8_t registerAddress, uint8_t data){
+   this->registers[registerAddress % BISS_REGISTERS] = data;
+}
+
+// MB4Simulator constructor: a powered up MB4 with no encoders attached
+// Parameters:
+// selectPin: the chip select pin the simulated MB4 listens to
+MB4Simulator::MB4Simulator(uint8_t selectPin){
+   this->selectPin = selectPin;
+   this->interruptPin = -1;
+   this->maxSPIClock = MAX_SPI_CLOCK;
+   this->cyclePeriod = SIM_CYCLE_PERIOD;
+   this->cycleTime = SIM_CYCLE_TIME;
+   this->randomState = 1;
+
+   for(uint8_t slave = 0; slave < MAX_SLAVES; slave++){
+      this->encoders[slave] = 0;
+   }
+   this->reset();
+
+   simAttachPin(selectPin, this);
+   simAddTimeListener(this);
+   SPI.simAddDevice(this);
+}
+
+MB4Simulator::~MB4Simulator(){
+   simAttachPin(this->selectPin, 0);
+   simRemoveTimeListener(this);
+   SPI.simRemoveDevice(this);
+}
+
+// reset: puts the registers and cycles back as they are at power up
+// Parameters: None
+// returns: nothing
+void MB4Simulator::reset(){
+   memset(this->registers, 0, sizeof(this->registers));
+   this->registers[STATUS_REG] = SIM_STATUS_IDLE;
+   this->registers[VERSION] = SIM_VERSION;
+   this->registers[REVISION] = SIM_REVISION;
+
+   this->selected = false;
+   this->state = spi_ignore;
+   this->nextState = spi_ignore;
+   this->address = 0;
+   this->spiStatus = 0;
+
+   this->cycleActive = false;
+   this->bankWaiting = false;
+   this->registerCycles = 0;
+   this->cycles = 0;
+   this->transactions = 0;
+   this->bytes = 0;
+   memset(this->lockedPositions, 0, sizeof(this->lockedPositions));
+}
+
+// attachEncoder: connects an encoder as a slave of the MB4
+// Parameters: 
+// slave: the position of the slave, the slaves of Channel 1 come first
+// encoder: the encoder, or 0 to leave the slave unconnected
+// returns: nothing
+void MB4Simulator::attachEncoder(uint8_t slave, EncoderModel* encoder){
+   if (slave < MAX_SLAVES) {
+      this->encoders[slave] = encoder;
+   }
+}
+
+// setInterruptPin: wires the end of transmission output to a pin
+// Parameters: 
+// pin: the pin, or -1 to leave the output unconnected
+// returns: nothing
+void MB4Simulator::setInterruptPin(int8_t pin){
+   this->interruptPin = pin;
+}
+
+// setCyclePeriod: sets the time between the start of AGS cycles
+// Parameters: 
+// nanos: the period in nanoseconds
+// returns: nothing
+void MB4Simulator::setCyclePeriod(uint32_t nanos){
+   this->cyclePeriod = nanos;
+}
+
+// setCycleTime: sets how long each cycle takes on the line
+// Parameters: 
+// nanos: the time in nanoseconds
+// returns: nothing
+void MB4Simulator::setCycleTime(uint32_t nanos){
+   this->cycleTime = nanos;
+}
+
+// setMaxSPIClock: sets the fastest SPI clock that is read without errors
+// Parameters: 
+// clock: the clock in Hz
+// returns: nothing
+void MB4Simulator::setMaxSPIClock(uint32_t clock){
+   this->maxSPIClock = clock;
+}
+
+// peekRegister: gets a register without the side effects of reading it 
+//               over SPI
+// Parameters: 
+// registerAddress: the register to get
+// returns: the value of the register
+uint8_t MB4Simulator::peekRegister(uint8_t registerAddress){
+   return this->registers[registerAddress];
+}
+
+// getLockedPosition: gets the position that was in a slave's bank when 
+//                    HOLDBANK was last set, to check a frame read against
+// Parameters: 
+// slave: the slave to get the position of
+// returns: the raw position with the status bits shifted out
+uint32_t MB4Simulator::getLockedPosition(uint8_t slave){
+   return slave < MAX_SLAVES ? this->lockedPositions[slave] : 0;
+}
+
+// getCycles: gets the number of cycles finished since reset()
+// Parameters: None
+// returns: the number of cycles
+uint32_t MB4Simulator::getCycles(){
+   return this->cycles;
+}
+
+// getTransactions: gets the number of SPI transactions since reset()
+// Parameters: None
+// returns: the number of times the MB4 was selected
+uint32_t MB4Simulator::getTransactions(){
+   return this->transactions;
+}
+
+// getBytes: gets the number of bytes transferred since reset()
+// Parameters: None
+// returns: the number of bytes, opcodes and addresses included
+uint32_t MB4Simulator::getBytes(){
+   return this->bytes;
+}
+
+// readRegister: reads a register as over SPI. Reading STATUS_REG clears the 
+//               bits latched in it.
+// Parameters: 
+// registerAddress: the register to read
+// returns: the value of the register
+uint8_t MB4Simulator::readRegister(uint8_t registerAddress){
+   uint8_t value = this->registers[registerAddress];
+   if (registerAddress == STATUS_REG) {
+      this->registers[STATUS_REG] = SIM_STATUS_IDLE;
+   }
+   return value;
+}
+
+// writeRegister: writes a register as over SPI. The status, version and 
+//                revision registers can't be written, INSTR is written as
+//                an instruction, and FREQAGS sets the cycle period.
+// Parameters: 
+// registerAddress: the register to write
+// data: the value to write
+// returns: nothing
+void MB4Simulator::writeRegister(uint8_t registerAddress, uint8_t data){
+   if (registerAddress == INSTR) {
+      this->writeInstruction(data);
+   }
+   else if (registerAddress == FREQAGS) {
+      this->registers[FREQAGS] = data;
+      uint32_t step = (data & AGS_COARSE) ? AGS_COARSE_STEP : AGS_FINE_STEP;
+      this->cyclePeriod = ((data & ~AGS_COARSE) + 1) * step * 1000;
+   }
+   else if (!(registerAddress >= STATUS_REG && registerAddress <= CDMTIMEOUT) &&
+            registerAddress != CDS_STATUS0 && registerAddress != CDS_STATUS1 &&
+            registerAddress != VERSION && registerAddress != REVISION) {
+      this->registers[registerAddress] = data;
+   }
+}
+
+// writeInstruction: carries out an instruction. BREAK stops everything and 
+//                   clears INSTR, INIT starts a single cycle and clears 
+//                   itself, AGS starts cycles every cycle period, clearing
+//                   HOLDBANK switches in a cycle held back while it was set,
+//                   and REGCOM starts register communication unless it is 
+//                   already running. The command bits read back as REGCOM 
+//                   until the register communication finishes.
+// Parameters: 
+// instruction: the instruction bits
+// returns: nothing
+void MB4Simulator::writeInstruction(uint8_t instruction){
+   uint64_t now = simNanos();
+
+   if (instruction & BREAK) {
+      this->registers[INSTR] = 0;
+      this->cycleActive = false;
+      this->bankWaiting = false;
+      this->registerCycles = 0;
+      return;
+   }
+
+   if ((instruction & INSTR_COMMAND_BITS) == REGCOM && this->registerCycles == 0) {
+      uint8_t count = MB4Fields::RegNum::get(this->registers[REGNUM]) + 1;
+      this->registerCycles = SIM_REGISTER_FRAME_CYCLES + count*SIM_REGISTER_BYTE_CYCLES;
+   }
+
+   uint8_t previous = this->registers[INSTR];
+   this->registers[INSTR] = (instruction & ~(INIT | INSTR_COMMAND_BITS)) 
+                            | (this->registerCycles ? REGCOM : 0);
+
+   if (!(previous & HOLDBANK) && (instruction & HOLDBANK)) {
+      // Remember what was locked in so that reads can be checked against it
+      for(uint8_t slave = 0; slave < MAX_SLAVES; slave++){
+         uint8_t* bank = this->registers + SCDATA1 + slave*SCDATA_SIZE;
+         uint32_t reading = 0;
+         for(uint8_t index = 0; index < 4; index++){
+            reading |= (uint32_t)bank[index] << (index*8);
+         }
+         this->lockedPositions[slave] = reading >> 2;
+      }
+   }
+   else if ((previous & HOLDBANK) && !(instruction & HOLDBANK) && this->bankWaiting) {
+      this->switchBank();
+   }
+
+   if ((instruction & INIT) && !this->cycleActive) {
+      this->startCycle(now);
+   }
+
+   if ((instruction & AGS) && !(previous & AGS)) {
+      this->nextCycleStart = now;
+   }
+}
+
+// startCycle: starts a cycle, every encoder latching its position at the 
+//             start
+// Parameters: 
+// nanos: the simulated time the cycle starts at
+// returns: nothing
+void MB4Simulator::startCycle(uint64_t nanos){
+   for(uint8_t slave = 0; slave < MAX_SLAVES; slave++){
+      EncoderModel* encoder = this->encoders[slave];
+      this->lineAnswered[slave] = encoder != 0 && 
+         encoder->sendFrame(nanos, this->lineData[slave], this->lineCRC[slave]);
+   }
+
+   this->cycleActive = true;
+   this->cycleEnd = nanos + this->cycleTime;
+}
+
+// finishCycle: ends the cycle on the line. The MB4 checks the CRC of each 
+//              frame, fills in the banks and SVALID (or holds them back if 
+//              HOLDBANK is set), latches EOT and any errors into STATUS_REG,
+//              and signals the end of transmission.
+// Parameters: None
+// returns: nothing
+void MB4Simulator::finishCycle(){
+   this->cycleActive = false;
+   this->cycles++;
+
+   bool held = this->registers[INSTR] & HOLDBANK;
+   if (held && this->bankWaiting) {
+      // The cycle held back is replaced without ever being seen
+      this->registers[STATUS_REG] |= STATUS_SWBANKFAILS;
+   }
+   if (!held || !this->bankWaiting) {
+      // Start from the banks as they are so unanswered slaves keep their data
+      memcpy(this->heldBanks, this->registers + SCDATA1, sizeof(this->heldBanks));
+   }
+
+   uint8_t errors = 0;
+   memset(this->heldSValid, 0, sizeof(this->heldSValid));
+   for(uint8_t slave = 0; slave < MAX_SLAVES; slave++){
+      if (!this->lineAnswered[slave]) {
+         continue;
+      }
+
+      uint8_t* bank = this->heldBanks + slave*SCDATA_SIZE;
+      uint32_t data = this->lineData[slave];
+      for(uint8_t index = 0; index < 4; index++){
+         bank[index] = data >> (index*8);
+      }
+      bank[SCDATA_CRC_OFFSET] = this->lineCRC[slave];
+
+      if (EncoderModel::bitwiseCRC6(data, BISS_CRC6_DATA_BITS) == 
+          (~this->lineCRC[slave] & 0x3F)) {
+         this->heldSValid[slave / 4] |= 2 << ((slave % 4) * 2);
+      }
+      else {
+         errors |= STATUS_NSCDERR | STATUS_NERR;
+      }
+   }
+
+   // Latch EOT and the errors, which are low active
+   this->registers[STATUS_REG] = (this->registers[STATUS_REG] | STATUS_EOT) & ~errors;
+
+   // Each cycle carries one more CDM bit of the register communication
+   if (this->registerCycles > 0 && --this->registerCycles == 0) {
+      this->finishRegisterCommunication();
+   }
+
+   this->bankWaiting = true;
+   if (!held) {
+      this->switchBank();
+   }
+
+   if (this->interruptPin >= 0) {
+      simTriggerPin(this->interruptPin);
+   }
+}
+
+// switchBank: switches the banks of the last cycle in
+// Parameters: None
+// returns: nothing
+void MB4Simulator::switchBank(){
+   memcpy(this->registers + SCDATA1, this->heldBanks, sizeof(this->heldBanks));
+   memcpy(this->registers + SVALID, this->heldSValid, sizeof(this->heldSValid));
+   this->bankWaiting = false;
+}
+
+// finishRegisterCommunication: carries out the register communication once
+//                              all of its control frame has been sent. Read
+//                              registers are placed into RDATA, written ones
+//                              are taken from it. REGEND is latched, along 
+//                              with NREGERR if the slave isn't connected.
+// Parameters: None
+// returns: nothing
+void MB4Simulator::finishRegisterCommunication(){
+   uint8_t slave = MB4Fields::SlaveId::get(this->registers[SLAVEID]);
+   uint8_t address = MB4Fields::RegAdr::get(this->registers[REGADR]);
+   bool write = MB4Fields::Wnr::get(this->registers[REGADR]);
+   uint8_t count = MB4Fields::RegNum::get(this->registers[REGNUM]) + 1;
+
+   EncoderModel* encoder = this->encoders[slave];
+   if (encoder == 0) {
+      this->registers[STATUS_REG] &= ~(STATUS_NREGERR | STATUS_NERR);
+   }
+   else {
+      for(uint8_t index = 0; index < count; index++){
+         if (write) {
+            encoder->writeBissRegister(address + index, this->registers[RDATA + index]);
+         }
+         else {
+            this->registers[RDATA + index] = encoder->readBissRegister(address + index);
+         }
+      }
+   }
+
+   this->registers[STATUS_REG] |= STATUS_REGEND;
+   this->registers[INSTR] &= ~INSTR_COMMAND_BITS;
+}
+
+// transfer: takes a byte of an SPI transaction
+// Parameters: 
+// data: the byte sent to the MB4
+// clock: the SPI clock it was sent at
+// returns: the byte the MB4 sends back
+uint8_t MB4Simulator::transfer(uint8_t data, uint32_t clock){
+   // Above the fastest clock a random bit of what is read goes wrong
+   uint8_t corruption = 0;
+   if (clock > this->maxSPIClock) {
+      uint32_t x = this->randomState;
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      this->randomState = x;
+      corruption = (x & 0x100) ? 1 << (x & 0x07) : 0;
+   }
+
+   this->bytes++;
+
+   uint8_t received = 0;
+   switch (this->state) {
+      case spi_opcode:
+         this->state = spi_address;
+         if (data == READ_DATA) {
+            this->nextState = spi_read;
+         }
+         else if (data == WRITE_DATA) {
+            this->nextState = spi_write;
+         }
+         else if (data == READ_DATA0 || data == WRITE_DATA0) {
+            this->address = SCDATA1;
+            this->state = (data == READ_DATA0) ? spi_read : spi_write;
+         }
+         else if (data == WRITE_INSTRUCTION) {
+            this->state = spi_instruction;
+         }
+         else if (data == READ_STATUS) {
+            this->state = spi_status;
+         }
+         else {
+            this->spiStatus |= SIM_SPI_STATUS_FAIL;
+            this->state = spi_ignore;
+         }
+         break;
+
+      case spi_address:
+         this->address = data;
+         this->state = this->nextState;
+         break;
+
+      case spi_read:
+         received = this->readRegister(this->address++) ^ corruption;
+         break;
+
+      case spi_write:
+         this->writeRegister(this->address++, data ^ corruption);
+         break;
+
+      case spi_instruction:
+         this->writeInstruction(data ^ corruption);
+         this->state = spi_ignore;
+         break;
+
+      case spi_status:
+         received = this->spiStatus;
+         this->spiStatus = 0;
+         break;
+
+      default:
+         break;
+   }
+
+   return received;
+}
+
+// isSelected: checks if the chip select of the MB4 is low
+// Parameters: None
+// returns: true if the MB4 is selected
+bool MB4Simulator::isSelected(){
+   return this->selected;
+}
+
+// pinWritten: follows the chip select, starting a new transaction each time 
+//             it goes low
+// Parameters: 
+// pin: the pin written
+// value: the value written
+// returns: nothing
+void MB4Simulator::pinWritten(uint8_t pin, uint8_t value){
+   if (pin == this->selectPin) {
+      if (value == LOW && !this->selected) {
+         this->transactions++;
+      }
+      this->selected = (value == LOW);
+      this->state = this->selected ? spi_opcode : spi_ignore;
+   }
+}
+
+// timeChanged: runs the cycles that start or finish up to the given time
+// Parameters: 
+// nanos: the simulated time in nanoseconds
+// returns: nothing
+void MB4Simulator::timeChanged(uint64_t nanos){
+   while (true) {
+      if (this->cycleActive) {
+         if (nanos < this->cycleEnd) {
+            return;
+         }
+         this->finishCycle();
+      }
+      else if ((this->registers[INSTR] & AGS) && nanos >= this->nextCycleStart) {
+         this->startCycle(this->nextCycleStart);
+
+         // A cycle can't start before the last one finished
+         this->nextCycleStart += this->cyclePeriod;
+         if (this->nextCycleStart < this->cycleEnd) {
+            this->nextCycleStart = this->cycleEnd;
+         }
+      }
+      else {
+         return;
+      }
+   }
+}
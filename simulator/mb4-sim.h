@@ -0,0 +1,272 @@
+/* mb4-sim.h
+   Register level simulation of an IC-MB4 with BiSS C encoders, for the host.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef MB4_SIM_H
+#define MB4_SIM_H
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// The register addresses, opcodes and instruction bits are shared with the 
+// driver, so that both always agree on them
+#include "mb4-driver.h"
+
+// Value STATUS_REG returns to when it is read: no errors, nothing latched
+#define SIM_STATUS_IDLE      STATUS_LOW_ACTIVE
+
+// Bit of the byte returned by READ_STATUS that is set when an unknown opcode
+// was sent since it was last read
+#define SIM_SPI_STATUS_FAIL  0x01
+
+// VERSION and REVISION reported by the simulated chip
+#define SIM_VERSION          0x01
+#define SIM_REVISION         0x00
+
+// Default time between the start of AGS cycles, and how long each cycle 
+// takes on the line, in nanoseconds. These are set with setCyclePeriod() and
+// setCycleTime(). Writing FREQAGS also sets the period, FREQ is not decoded.
+#define SIM_CYCLE_PERIOD     200000
+#define SIM_CYCLE_TIME       10000
+
+// Mask of the position bits sent by the encoder
+#define SIM_POSITION_MASK    0x03FFFFFFUL
+
+// Cycles register communication takes: the CDM bits of the control frame 
+// before the data (start, CTS, slave ID, address and CRC), and those of each
+// register after it (data, CRC and stop)
+#define SIM_REGISTER_FRAME_CYCLES   30
+#define SIM_REGISTER_BYTE_CYCLES    14
+
+// Number of registers of the encoder that take writes, starting at 0. The 
+// rest are the identification registers of the BiSS standard.
+#define SIM_WRITABLE_REGISTERS      0x40
+
+// EncoderModel: a BiSS C encoder like the Renishaw LMA10. It sends a 26 bit 
+//               position, two status bits and the inverted CRC6 of both, and
+//               can be made to send corrupted frames or none at all. It has
+//               the registers of a BiSS C slave, with a serial number worked
+//               out from the seed. Faults
+//               are drawn from its own random number generator, so a run with
+//               the same seed always sees the same faults.
+class EncoderModel {
+   private:
+      // Motion profile: the position in counts is 
+      // start + velocity*t + amplitude*sin(2*pi*t/period), t in seconds
+      double start;
+      double velocity;
+      double amplitude;
+      double period;
+
+      // Status bits sent with every frame (bit 1:0)
+      uint8_t status;
+
+      // Chance of each frame having a bit flipped on the line, or of the 
+      // encoder not answering at all, and faults injected for the next frames
+      double crcErrorRate;
+      double dropRate;
+      uint16_t injectedCRCErrors;
+      uint16_t injectedDrops;
+
+      uint32_t randomState;
+
+      uint32_t random();
+
+      bool chance(double probability);
+
+      uint8_t registers[BISS_REGISTERS];
+
+   public:
+      EncoderModel(uint32_t seed = 1);
+
+      void setMotion(double start, double velocity, double amplitude = 0, 
+                     double period = 1);
+
+      void setStatus(uint8_t status);
+
+      void setCRCErrorRate(double probability);
+
+      void setDropRate(double probability);
+
+      void injectCRCErrors(uint16_t count);
+
+      void injectDrops(uint16_t count);
+
+      uint32_t getPosition(uint64_t nanos);
+
+      bool sendFrame(uint64_t nanos, uint32_t& data, uint8_t& crc);
+
+      uint8_t readBissRegister(uint8_t registerAddress);
+
+      void writeBissRegister(uint8_t registerAddress, uint8_t data);
+
+      void setBissRegister(uint8_t registerAddress, uint8_t data);
+
+      static uint8_t bitwiseCRC6(uint32_t data, uint8_t numBits);
+};
+
+// MB4Simulator class: an IC-MB4 as seen over SPI. It implements the opcodes
+//                     used by the MB4Driver (READ_DATA, WRITE_DATA, 
+//                     READ_DATA0, WRITE_DATA0, WRITE_INSTRUCTION and 
+//                     READ_STATUS), a register file, the BREAK, INIT, AGS,
+//                     HOLDBANK and REGCOM instructions, the SVALID and 
+//                     STATUS_REG bits of each cycle and the end of 
+//                     transmission output. Register communication takes as 
+//                     many cycles as its control frame has CDM bits. Slaves 
+//                     are EncoderModels attached by position. Reading above 
+//                     setMaxSPIClock() corrupts the bytes read, as bad wiring 
+//                     would. 
+//
+// The simulator attaches itself to the select pin, the SPI bus and the 
+// simulated clock of the stand-in Arduino core, so an MB4Driver on the same 
+// select pin talks to it unchanged.
+class MB4Simulator : public SimSPIDevice, public SimPinListener, public SimTimeListener {
+   private:
+      uint8_t selectPin;
+      bool selected;
+
+      // Pin the end of transmission output is wired to, or -1 if none
+      int8_t interruptPin;
+
+      uint8_t registers[256];
+
+      // State of the SPI transaction in progress
+      enum spiState
+      {
+         spi_opcode,       // Waiting for the opcode
+         spi_address,      // Waiting for the address of a read or write
+         spi_read,         // Sending registers
+         spi_write,        // Receiving registers
+         spi_instruction,  // Waiting for the instruction
+         spi_status,       // Sending the SPI status
+         spi_ignore        // Ignoring the rest of the transaction
+
+      } state, nextState;
+      uint8_t address;
+      uint8_t spiStatus;
+
+      // Fastest SPI clock that is read reliably
+      uint32_t maxSPIClock;
+
+      // AGS and cycle timing
+      uint32_t cyclePeriod;
+      uint32_t cycleTime;
+      uint64_t nextCycleStart;
+      uint64_t cycleEnd;
+      bool cycleActive;
+
+      // The encoders attached to each slave, and the frames of the cycle on
+      // the line
+      EncoderModel* encoders[MAX_SLAVES];
+      uint32_t lineData[MAX_SLAVES];
+      uint8_t lineCRC[MAX_SLAVES];
+      bool lineAnswered[MAX_SLAVES];
+
+      // A finished cycle held back by HOLDBANK, switched in when it is cleared
+      uint8_t heldBanks[MAX_SLAVES * SCDATA_SIZE];
+      uint8_t heldSValid[(MAX_SLAVES + 3) / 4];
+      bool bankWaiting;
+
+      // The position in the bank of each slave when HOLDBANK was last set
+      uint32_t lockedPositions[MAX_SLAVES];
+
+      // Cycles left until the register communication in progress finishes,
+      // 0 if there is none
+      uint16_t registerCycles;
+
+      uint32_t cycles;
+      uint32_t randomState;
+
+      // SPI transactions and bytes taken since reset()
+      uint32_t transactions;
+      uint32_t bytes;
+
+      uint8_t readRegister(uint8_t registerAddress);
+
+      void writeRegister(uint8_t registerAddress, uint8_t data);
+
+      void writeInstruction(uint8_t instruction);
+
+      void startCycle(uint64_t nanos);
+
+      void finishCycle();
+
+      void switchBank();
+
+      void finishRegisterCommunication();
+
+   public:
+      MB4Simulator(uint8_t selectPin);
+
+      ~MB4Simulator();
+
+      void reset();
+
+      void attachEncoder(uint8_t slave, EncoderModel* encoder);
+
+      void setInterruptPin(int8_t pin);
+
+      void setCyclePeriod(uint32_t nanos);
+
+      void setCycleTime(uint32_t nanos);
+
+      void setMaxSPIClock(uint32_t clock);
+
+      uint8_t peekRegister(uint8_t registerAddress);
+
+      uint32_t getLockedPosition(uint8_t slave);
+
+      uint32_t getCycles();
+
+      uint32_t getTransactions();
+
+      uint32_t getBytes();
+
+      // SimSPIDevice, SimPinListener and SimTimeListener
+      virtual uint8_t transfer(uint8_t data, uint32_t clock);
+
+      virtual bool isSelected();
+
+      virtual void pinWritten(uint8_t pin, uint8_t value);
+
+      virtual void timeChanged(uint64_t nanos);
+};
+
+#endif
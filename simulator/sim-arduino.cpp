@@ -0,0 +1,408 @@
+/* sim-arduino.cpp
+   Host stand-in for the Arduino core and SPI library on a simulated clock.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <stdio.h>
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <EEPROM.h>
+
+// Highest pin number that can be written or have a listener attached
+#define SIM_PINS            32
+
+// Most time listeners and SPI devices that can be added
+#define SIM_LISTENERS       8
+
+// Number of external interrupts (INT0 on D2 and INT1 on D3)
+#define SIM_INTERRUPTS      2
+
+// Steps the clock is moved forward in by delay(), so that everything running
+// on the simulated clock still sees every event while the code is waiting
+#define SIM_DELAY_STEP_NS   1000
+
+HardwareSerial Serial;
+SPIClass SPI;
+SimSREG SREG;
+EEPROMClass EEPROM;
+
+// The simulated time in nanoseconds
+static uint64_t nowNanos = 0;
+
+// Pin values written and the listeners attached to pins
+static uint8_t pinValues[SIM_PINS];
+static SimPinListener* pinListeners[SIM_PINS];
+
+static SimTimeListener* timeListeners[SIM_LISTENERS];
+static uint8_t numTimeListeners = 0;
+
+// External interrupt state: the service routines attached, the interrupts 
+// that have been triggered but not yet serviced, whether interrupts are 
+// globally enabled, and whether a service routine is already running
+static void (*interruptRoutines[SIM_INTERRUPTS])();
+static bool interruptPending[SIM_INTERRUPTS];
+static bool interruptsEnabled = true;
+static bool inInterrupt = false;
+
+// Interrupts held off by SPI transactions (see SPI.usingInterrupt()), and 
+// those that are held off right now because a transaction is open
+static uint8_t spiInterruptMask = 0;
+static uint8_t maskedInterrupts = 0;
+
+// The SPI bus: the devices on it and the clock of the current transaction
+static SimSPIDevice* spiDevices[SIM_LISTENERS];
+static uint8_t numSPIDevices = 0;
+static uint32_t spiClock = 4000000;
+
+// serviceInterrupts: runs the service routine of every pending interrupt that
+//                    is allowed to run right now, as the AVR would as soon as
+//                    interrupts are enabled again
+// Parameters: None
+// returns: nothing
+static void serviceInterrupts(){
+   if (!interruptsEnabled || inInterrupt) {
+      return;
+   }
+
+   for(uint8_t number = 0; number < SIM_INTERRUPTS; number++){
+      if (interruptPending[number] && interruptRoutines[number] != 0 && 
+          !(maskedInterrupts & (1 << number))) {
+         interruptPending[number] = false;
+
+         // Interrupts are disabled while a service routine runs
+         inInterrupt = true;
+         interruptsEnabled = false;
+         interruptRoutines[number]();
+         interruptsEnabled = true;
+         inInterrupt = false;
+      }
+   }
+}
+
+void pinMode(uint8_t pin, uint8_t mode){
+   if (pin < SIM_PINS && mode == INPUT_PULLUP) {
+      pinValues[pin] = HIGH;
+   }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value){
+   if (pin >= SIM_PINS) {
+      return;
+   }
+
+   pinValues[pin] = value;
+   if (pinListeners[pin] != 0) {
+      pinListeners[pin]->pinWritten(pin, value);
+   }
+   simAdvance(SIM_DIGITAL_WRITE_NS);
+}
+
+int digitalRead(uint8_t pin){
+   return pin < SIM_PINS ? pinValues[pin] : LOW;
+}
+
+unsigned long millis(){
+   simAdvance(SIM_MICROS_NS);
+   return (unsigned long)(nowNanos / 1000000);
+}
+
+unsigned long micros(){
+   simAdvance(SIM_MICROS_NS);
+   return (unsigned long)(nowNanos / 1000);
+}
+
+void delay(unsigned long ms){
+   for(unsigned long us = 0; us < ms * 1000; us++){
+      simAdvance(SIM_DELAY_STEP_NS);
+   }
+}
+
+void delayMicroseconds(unsigned int us){
+   for(unsigned int step = 0; step < us; step++){
+      simAdvance(SIM_DELAY_STEP_NS);
+   }
+}
+
+void attachInterrupt(uint8_t interruptNumber, void (*isr)(), int mode){
+   (void)mode;
+   if (interruptNumber < SIM_INTERRUPTS) {
+      interruptRoutines[interruptNumber] = isr;
+      interruptPending[interruptNumber] = false;
+   }
+}
+
+void detachInterrupt(uint8_t interruptNumber){
+   if (interruptNumber < SIM_INTERRUPTS) {
+      interruptRoutines[interruptNumber] = 0;
+   }
+}
+
+void noInterrupts(){
+   interruptsEnabled = false;
+}
+
+void interrupts(){
+   interruptsEnabled = true;
+   serviceInterrupts();
+}
+
+SimSREG::operator uint8_t() const {
+   return interruptsEnabled ? 0x80 : 0x00;
+}
+
+SimSREG& SimSREG::operator=(uint8_t value){
+   if (value & 0x80) {
+      interrupts();
+   }
+   else {
+      noInterrupts();
+   }
+   return *this;
+}
+
+// simAttachPin: attaches a listener that is told whenever pin is written
+// Parameters: 
+// pin: the pin to listen to
+// listener: the listener to tell
+// returns: nothing
+void simAttachPin(uint8_t pin, SimPinListener* listener){
+   if (pin < SIM_PINS) {
+      pinListeners[pin] = listener;
+   }
+}
+
+// simAddTimeListener: adds a listener that is told whenever the clock moves
+// Parameters: 
+// listener: the listener to add
+// returns: nothing
+void simAddTimeListener(SimTimeListener* listener){
+   if (numTimeListeners < SIM_LISTENERS) {
+      timeListeners[numTimeListeners++] = listener;
+   }
+}
+
+// simRemoveTimeListener: removes a listener added by simAddTimeListener()
+// Parameters: 
+// listener: the listener to remove
+// returns: nothing
+void simRemoveTimeListener(SimTimeListener* listener){
+   for(uint8_t index = 0; index < numTimeListeners; index++){
+      if (timeListeners[index] == listener) {
+         timeListeners[index] = timeListeners[--numTimeListeners];
+         return;
+      }
+   }
+}
+
+// simNanos: gets the simulated time
+// Parameters: None
+// returns: the simulated time in nanoseconds
+uint64_t simNanos(){
+   return nowNanos;
+}
+
+// simAdvance: moves the simulated clock forward, letting everything running 
+//             on the clock catch up and then servicing any interrupts that 
+//             were triggered
+// Parameters: 
+// nanos: the time to move forward in nanoseconds
+// returns: nothing
+void simAdvance(uint64_t nanos){
+   nowNanos += nanos;
+   for(uint8_t index = 0; index < numTimeListeners; index++){
+      timeListeners[index]->timeChanged(nowNanos);
+   }
+   serviceInterrupts();
+}
+
+// simTriggerPin: signals the edge on a pin that triggers its external 
+//                interrupt. The service routine runs as soon as interrupts 
+//                allow, and an interrupt triggered again before then is only
+//                serviced once, as on the AVR.
+// Parameters: 
+// pin: the pin the edge happened on
+// returns: nothing
+void simTriggerPin(uint8_t pin){
+   int8_t number = digitalPinToInterrupt(pin);
+   if (number != NOT_AN_INTERRUPT && interruptRoutines[number] != 0) {
+      interruptPending[number] = true;
+   }
+}
+
+void SPIClass::begin(){
+}
+
+void SPIClass::end(){
+}
+
+void SPIClass::beginTransaction(SPISettings settings){
+   maskedInterrupts = spiInterruptMask;
+   spiClock = settings.clock;
+   simAdvance(SIM_SPI_TRANSACTION_NS);
+}
+
+void SPIClass::endTransaction(){
+   maskedInterrupts = 0;
+   serviceInterrupts();
+}
+
+uint8_t SPIClass::transfer(uint8_t data){
+   uint8_t received = 0xFF;
+   for(uint8_t index = 0; index < numSPIDevices; index++){
+      if (spiDevices[index]->isSelected()) {
+         received = spiDevices[index]->transfer(data, spiClock);
+         break;
+      }
+   }
+
+   simAdvance(8000000000ULL / spiClock + SIM_SPI_BYTE_OVERHEAD_NS);
+   return received;
+}
+
+void SPIClass::transfer(void* buffer, size_t count){
+   uint8_t* bytes = (uint8_t*)buffer;
+   for(size_t index = 0; index < count; index++){
+      bytes[index] = transfer(bytes[index]);
+   }
+}
+
+void SPIClass::usingInterrupt(uint8_t interruptNumber){
+   if (interruptNumber < SIM_INTERRUPTS) {
+      spiInterruptMask |= 1 << interruptNumber;
+   }
+}
+
+void SPIClass::notUsingInterrupt(uint8_t interruptNumber){
+   if (interruptNumber < SIM_INTERRUPTS) {
+      spiInterruptMask &= ~(1 << interruptNumber);
+   }
+}
+
+void SPIClass::simAddDevice(SimSPIDevice* device){
+   if (numSPIDevices < SIM_LISTENERS) {
+      spiDevices[numSPIDevices++] = device;
+   }
+}
+
+void SPIClass::simRemoveDevice(SimSPIDevice* device){
+   for(uint8_t index = 0; index < numSPIDevices; index++){
+      if (spiDevices[index] == device) {
+         spiDevices[index] = spiDevices[--numSPIDevices];
+         return;
+      }
+   }
+}
+
+uint8_t EEPROMClass::read(int address){
+   return this->bytes[address % SIM_EEPROM_SIZE];
+}
+
+void EEPROMClass::write(int address, uint8_t value){
+   this->bytes[address % SIM_EEPROM_SIZE] = value;
+}
+
+void EEPROMClass::update(int address, uint8_t value){
+   this->write(address, value);
+}
+
+uint16_t EEPROMClass::length(){
+   return SIM_EEPROM_SIZE;
+}
+
+void HardwareSerial::begin(unsigned long baud){
+   (void)baud;
+}
+
+HardwareSerial::operator bool(){
+   return true;
+}
+
+// printNumber: prints an unsigned number in the given base
+// Parameters: 
+// number: the number to print
+// base: the base to print it in (DEC, HEX or BIN)
+// returns: the number of characters printed
+static size_t printNumber(unsigned long number, int base){
+   if (base == HEX) {
+      return printf("%lX", number);
+   }
+   if (base == BIN) {
+      char digits[33];
+      uint8_t length = 0;
+      do {
+         digits[length++] = '0' + (number & 1);
+         number >>= 1;
+      } while (number != 0);
+      for(uint8_t index = length; index > 0; index--){
+         putchar(digits[index - 1]);
+      }
+      return length;
+   }
+   return printf("%lu", number);
+}
+
+size_t Print::write(uint8_t data){ return fwrite(&data, 1, 1, stdout); }
+size_t Print::write(const uint8_t* data, size_t size){ return fwrite(data, 1, size, stdout); }
+
+size_t Print::print(const char* text){ return printf("%s", text); }
+size_t Print::print(char character){ return printf("%c", character); }
+size_t Print::print(unsigned char number, int base){ return printNumber(number, base); }
+size_t Print::print(unsigned int number, int base){ return printNumber(number, base); }
+size_t Print::print(unsigned long number, int base){ return printNumber(number, base); }
+size_t Print::print(int number, int base){ return this->print((long)number, base); }
+
+size_t Print::print(long number, int base){
+   if (base == DEC && number < 0) {
+      return putchar('-') == EOF ? 0 : 1 + printNumber(-(unsigned long)number, base);
+   }
+   return printNumber((unsigned long)number, base);
+}
+
+size_t Print::print(double number, int digits){ return printf("%.*f", digits, number); }
+
+size_t Print::println(){ return printf("\n"); }
+size_t Print::println(const char* text){ return this->print(text) + this->println(); }
+size_t Print::println(char character){ return this->print(character) + this->println(); }
+size_t Print::println(unsigned char number, int base){ return this->print(number, base) + this->println(); }
+size_t Print::println(int number, int base){ return this->print(number, base) + this->println(); }
+size_t Print::println(unsigned int number, int base){ return this->print(number, base) + this->println(); }
+size_t Print::println(long number, int base){ return this->print(number, base) + this->println(); }
+size_t Print::println(unsigned long number, int base){ return this->print(number, base) + this->println(); }
+size_t Print::println(double number, int digits){ return this->print(number, digits) + this->println(); }
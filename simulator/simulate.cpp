@@ -0,0 +1,519 @@
+/* simulate.cpp
+   Runs the MB4Driver against the MB4 simulator on the host and checks its readings.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <stdio.h>
+
+#include "mb4-sim.h"
+#include "mb4-driver.h"
+#include "mb4-bus.h"
+
+// Pins the simulated MB4 is wired to, as on the prototype circuit
+#define SELECT_PIN      10
+#define INTERRUPT_PIN   2
+
+// Select pin of a second MB4 on the same bus, for synchronized capture
+#define SECOND_SELECT_PIN   9
+
+// Select pin of a driver that is never started, with no MB4 behind it
+#define UNSTARTED_SELECT_PIN   8
+
+// Number of frames read in each polled run
+#define POLLED_READS    2000
+
+// Simulated time spent capturing on the end of transmission interrupt, in ms
+#define ACQUISITION_TIME   200
+
+// Number of frames corrupted on the line while polling
+#define INJECTED_CRC_ERRORS   25
+
+// Number of positions polled while tracing, when built with MB4_TRACE
+#define TRACED_CALLS   4
+
+// Number of synchronized captures of both MB4s, and the furthest a captured
+// position may be from the true position at the capture timestamp, in counts
+#define SYNC_CAPTURES    500
+#define SYNC_TOLERANCE   32
+
+// The scheduled reads of the bus may miss at most one in this many cycles
+#define BUS_MISSED_FRACTION   20
+
+// Cycle period set while polling, and the fast and slow periods of the 
+// adaptive rate, in microseconds. The adaptive rate speeds up at 
+// ADAPTIVE_VELOCITY in position units per second.
+#define POLLED_PERIOD       1000
+#define ADAPTIVE_FAST       200
+#define ADAPTIVE_SLOW       2000
+#define ADAPTIVE_VELOCITY   INCHES_TO_POSITION(0.5)
+
+// Number of samples in the burst capture, its cycle period in microseconds 
+// and SPI clock in Hz, and the furthest a sample may be from the true 
+// position, in counts
+#define BURST_SAMPLES     500
+#define BURST_PERIOD      100
+#define BURST_SPI_CLOCK   8000000
+#define BURST_TOLERANCE   32
+
+// Encoder registers written and read back during interrupt capture
+#define TEST_REGISTER        0x10
+#define TEST_REGISTER_SIZE   4
+
+// transferRegisters: runs the register communication steps of the 
+//                    interrupt capture, one step per call: read the device
+//                    and manufacturer IDs in a single request, then write 
+//                    test registers and read them back
+// Parameters: 
+// driver: the driver to communicate with
+// encoder: the encoder being communicated with
+// step: the step to run, moved on once it is done
+// returns: false if a step failed or read back the wrong registers
+static bool transferRegisters(MB4Driver& driver, EncoderModel& encoder, uint8_t& step){
+   static const uint8_t written[TEST_REGISTER_SIZE] = {0xDE, 0xAD, 0xBE, 0xEF};
+   uint8_t data[BISS_DEVICE_ID_SIZE + BISS_MANUFACTURER_ID_SIZE];
+
+   MB4Driver::registerTransfer state = driver.pollEncoderTransfer();
+   if (state == MB4Driver::transfer_failed) {
+      return false;
+   }
+
+   switch (step) {
+      case 0:
+         step += driver.requestEncoderRead(BISS_DEVICE_ID, sizeof(data));
+         break;
+
+      case 1:
+         if (driver.readEncoderData(data, sizeof(data))) {
+            printf("device %.6s from %.2s\n", (char*)data, (char*)data + BISS_DEVICE_ID_SIZE);
+            for(uint8_t index = 0; index < sizeof(data); index++){
+               if (data[index] != encoder.readBissRegister(BISS_DEVICE_ID + index)) {
+                  return false;
+               }
+            }
+            step++;
+         }
+         break;
+
+      case 2:
+         step += driver.requestEncoderWrite(TEST_REGISTER, (uint8_t*)written, 
+                                            TEST_REGISTER_SIZE);
+         break;
+
+      case 3:
+         if (state == MB4Driver::transfer_done) {
+            step += driver.requestEncoderRead(TEST_REGISTER, TEST_REGISTER_SIZE);
+         }
+         break;
+
+      case 4:
+         if (driver.readEncoderData(data, TEST_REGISTER_SIZE)) {
+            if (memcmp(data, written, TEST_REGISTER_SIZE) != 0) {
+               return false;
+            }
+            step++;
+         }
+         break;
+
+      default:
+         break;
+   }
+   return true;
+}
+
+// pollFrames: reads frames with the driver and checks every valid one 
+//             against the bank the simulator locked for it
+// Parameters: 
+// driver: the driver to read with
+// simulator: the simulated MB4 it reads from
+// invalid: incremented for every frame the driver reported as invalid. A 
+//          corrupted frame is counted again if it is read again before the 
+//          next cycle replaces it.
+// returns: the number of valid frames that did not match the locked bank
+static uint32_t pollFrames(MB4Driver& driver, MB4Simulator& simulator, 
+                           uint32_t& invalid){
+   uint32_t mismatches = 0;
+   for(uint32_t read = 0; read < POLLED_READS; read++){
+      MB4Driver::PositionFrame frame = driver.readPositionFrame();
+      if (frame.svalid != 2) {
+         invalid++;
+      }
+      else if (frame.rawPosition != simulator.getLockedPosition(0) ||
+               !driver.checkFrameCRC(frame)) {
+         mismatches++;
+      }
+   }
+   return mismatches;
+}
+
+// MemoryPrint: collects what is written to it, so a binary dump can be 
+//              decoded again
+class MemoryPrint : public Print {
+   public:
+      uint8_t data[BURST_HEADER_SIZE + BURST_SAMPLES*BURST_RECORD_SIZE + 2];
+      size_t size;
+
+      MemoryPrint() : size(0) {}
+
+      size_t write(uint8_t value){
+         return this->write(&value, 1);
+      }
+
+      size_t write(const uint8_t* values, size_t count){
+         for(size_t index = 0; index < count && this->size < sizeof(this->data); index++){
+            this->data[this->size++] = values[index];
+         }
+         return count;
+      }
+};
+
+// readLittleEndian: reads a little endian value out of a dump
+// Parameters: 
+// data: the first byte of the value
+// numBytes: the number of bytes in the value
+// returns: the value
+static uint32_t readLittleEndian(const uint8_t* data, uint8_t numBytes){
+   uint32_t value = 0;
+   for(uint8_t index = numBytes; index > 0; index--){
+      value = (value << 8) | data[index - 1];
+   }
+   return value;
+}
+
+// checkBurstDump: decodes a dump written by dumpBurst() and compares it with
+//                 the burst it was written from
+// Parameters: 
+// dump: the dump
+// burst: the burst it was written from
+// returns: true if the dump is complete and matches the burst
+static bool checkBurstDump(const MemoryPrint& dump, const BurstBuffer& burst){
+   if (dump.size != BURST_HEADER_SIZE + burst.count*BURST_RECORD_SIZE + 2u ||
+       memcmp(dump.data, BURST_MAGIC, BURST_MAGIC_SIZE) != 0 || 
+       dump.data[BURST_MAGIC_SIZE] != BURST_VERSION ||
+       readLittleEndian(dump.data + BURST_MAGIC_SIZE + 1, 2) != burst.count) {
+      return false;
+   }
+
+   uint16_t checksum = 0;
+   for(size_t index = BURST_MAGIC_SIZE; index < dump.size - 2; index++){
+      checksum += dump.data[index];
+   }
+   if (readLittleEndian(dump.data + dump.size - 2, 2) != checksum) {
+      return false;
+   }
+
+   uint32_t timestamp = readLittleEndian(dump.data + BURST_MAGIC_SIZE + 3, 4);
+   for(uint16_t sample = 0; sample < burst.count; sample++){
+      const uint8_t* record = dump.data + BURST_HEADER_SIZE + sample*BURST_RECORD_SIZE;
+      timestamp += readLittleEndian(record, 2);
+      uint32_t packed = readLittleEndian(record + 2, 4);
+      uint8_t status = (packed >> BURST_STATUS_SHIFT) & 0b00000011;
+      if (packed & BURST_INVALID_CRC) {
+         status |= SAMPLE_INVALID_CRC;
+      }
+      if (timestamp != burst.timestamps[sample] || status != burst.status[sample] ||
+          (packed & BURST_POSITION_MASK) != burst.positions[sample]) {
+         return false;
+      }
+   }
+   return true;
+}
+
+int main(){
+   EncoderModel encoder;
+   encoder.setMotion(1000000, 40000, 5000, 0.05);
+
+   MB4Simulator simulator(SELECT_PIN);
+   simulator.attachEncoder(0, &encoder);
+   simulator.setInterruptPin(INTERRUPT_PIN);
+
+   MB4Driver driver(SELECT_PIN, 0);
+   driver.begin();
+   while (!driver.poll()) {
+      if (driver.hasFailed()) {
+         printf("start up failed\n");
+         return 1;
+      }
+   }
+   printf("started in %lu us, configured: %s\n", micros(), 
+          driver.isConfigured() ? "yes" : "no");
+
+   // Polled reads, normal and fast access, with a few corrupted frames
+   uint32_t mismatches = 0;
+   uint32_t invalid = 0;
+   encoder.injectCRCErrors(INJECTED_CRC_ERRORS);
+   mismatches += pollFrames(driver, simulator, invalid);
+   driver.setFastAccess(true);
+   mismatches += pollFrames(driver, simulator, invalid);
+   printf("polled: %lu mismatched, %lu invalid (%d corrupted on the line)\n", 
+          (unsigned long)mismatches, (unsigned long)invalid, INJECTED_CRC_ERRORS);
+
+   // Polled reads with the CRC checked by the driver. The simulated encoder
+   // works out its CRCs bit by bit, so this checks the driver's table.
+   uint32_t softwareInvalid = 0;
+   driver.setSoftwareCRC(true);
+   encoder.injectCRCErrors(INJECTED_CRC_ERRORS);
+   uint32_t softwareMismatches = pollFrames(driver, simulator, softwareInvalid);
+   driver.setSoftwareCRC(false);
+   bool softwarePassed = softwareMismatches == 0 && softwareInvalid >= INJECTED_CRC_ERRORS &&
+                         softwareInvalid <= 2*INJECTED_CRC_ERRORS;
+   printf("software crc: %s, %lu mismatched, %lu invalid (%d corrupted on the line)\n",
+          softwarePassed ? "passed" : "FAILED", (unsigned long)softwareMismatches, 
+          (unsigned long)softwareInvalid, INJECTED_CRC_ERRORS);
+
+   // Capture on the end of transmission interrupt, with register 
+   // communication with the encoder going on alongside
+   SampleBuffer samples;
+   uint32_t firstCycle = simulator.getCycles();
+   uint32_t captured = 0;
+   uint8_t registerStep = 0;
+   bool registersPassed = true;
+   driver.beginInterruptAcquisition(INTERRUPT_PIN, &samples);
+   unsigned long start = millis();
+   uint32_t lastValid = 0;
+   Sample sample;
+   while (millis() - start < ACQUISITION_TIME) {
+      while (driver.readSample(sample)) {
+         captured++;
+         if (!(sample.status & SAMPLE_INVALID_CRC)) {
+            lastValid = sample.rawPosition;
+         }
+      }
+      registersPassed &= transferRegisters(driver, encoder, registerStep);
+   }
+
+   // Polling while the interrupt acquires must not touch the MB4, and gives 
+   // the position of the last valid sample collected
+   while (driver.readSample(sample)) {
+      captured++;
+      if (!(sample.status & SAMPLE_INVALID_CRC)) {
+         lastValid = sample.rawPosition;
+      }
+   }
+   uint32_t transactions = simulator.getTransactions();
+   bool pollGuarded = driver.getRawPosition() == lastValid &&
+                      !driver.addCalibrationReference(0) &&
+                      simulator.getTransactions() == transactions;
+   driver.endInterruptAcquisition();
+   printf("interrupt: %lu samples of %lu cycles, %u overruns, polling %s\n", 
+          (unsigned long)captured, (unsigned long)(simulator.getCycles() - firstCycle),
+          samples.getOverruns(), pollGuarded ? "refused" : "FAILED");
+   printf("registers: %s after %u steps\n", 
+          (registersPassed && registerStep == 5) ? "passed" : "FAILED", registerStep);
+
+   // Set the cycle period, then let the adaptive rate slow down while the 
+   // encoder is still and speed back up once it moves
+   uint32_t achieved = driver.setCyclePeriod(POLLED_PERIOD);
+   firstCycle = simulator.getCycles();
+   delay(100);
+   uint32_t polledCycles = simulator.getCycles() - firstCycle;
+
+   PositionObserver observer(20);
+   driver.setObserver(&observer);
+   driver.setAdaptiveRate(ADAPTIVE_FAST, ADAPTIVE_SLOW, ADAPTIVE_VELOCITY);
+   driver.beginInterruptAcquisition(INTERRUPT_PIN, &samples);
+   encoder.setMotion(encoder.getPosition(simNanos()), 0);
+   uint32_t stillPeriod = 0;
+   uint32_t movingPeriod = 0;
+   start = millis();
+   while (millis() - start < 2*ACQUISITION_TIME) {
+      Sample sample;
+      while (driver.readSample(sample)) {}
+      if (stillPeriod == 0 && millis() - start >= ACQUISITION_TIME) {
+         stillPeriod = driver.getCyclePeriod();
+         encoder.setMotion(encoder.getPosition(simNanos()) - 200000.0*simNanos()/1e9, 200000);
+      }
+   }
+   movingPeriod = driver.getCyclePeriod();
+   driver.endInterruptAcquisition();
+   driver.setObserver(0);
+   driver.setAdaptiveRate(0, 0, 0);
+   bool ratesPassed = achieved == POLLED_PERIOD && polledCycles >= 99 && polledCycles <= 101 &&
+                      stillPeriod == ADAPTIVE_SLOW && movingPeriod == ADAPTIVE_FAST;
+   printf("rate: %s, %lu us gave %lu cycles in 100 ms, adaptive %lu us still and "
+          "%lu us moving\n", ratesPassed ? "passed" : "FAILED", (unsigned long)achieved,
+          (unsigned long)polledCycles, (unsigned long)stillPeriod, (unsigned long)movingPeriod);
+
+   // At the slowest MA clock the cycle time is not a whole number of coarse 
+   // steps, so the shortest period has to be rounded up to fit it
+   uint32_t maClock = driver.getMAClock();
+   driver.setMAClock(1);
+   uint32_t slowCycleTime = driver.getCycleTime();
+   uint32_t slowPeriod = driver.setCyclePeriod(0);
+   uint32_t slowReported = driver.getCyclePeriod();
+   firstCycle = simulator.getCycles();
+   delay(100);
+   uint32_t slowCycles = simulator.getCycles() - firstCycle;
+   uint32_t finePeriod = driver.setCyclePeriod(AGS_MAX_STEPS * AGS_FINE_STEP + 1);
+   driver.setMAClock(maClock);
+   bool roundingPassed = slowCycleTime % AGS_COARSE_STEP != 0 && slowPeriod >= slowCycleTime &&
+                         slowPeriod < slowCycleTime + AGS_COARSE_STEP && 
+                         slowPeriod == slowReported &&
+                         slowCycles == 100000 / slowPeriod && finePeriod >= AGS_MAX_STEPS + 1;
+   ratesPassed &= roundingPassed;
+   printf("rounding: %s, %lu us cycles gave a %lu us period and %lu cycles in 100 ms, "
+          "%d us gave %lu us\n", roundingPassed ? "passed" : "FAILED", 
+          (unsigned long)slowCycleTime, (unsigned long)slowPeriod, (unsigned long)slowCycles,
+          AGS_MAX_STEPS * AGS_FINE_STEP + 1, (unsigned long)finePeriod);
+
+   driver.refreshHealth();
+   driver.printHealth();
+   driver.printTelemetry();
+
+   // Synchronized capture along with a second MB4 on the same bus
+   EncoderModel secondEncoder(2);
+   secondEncoder.setMotion(3000000, -25000, 8000, 0.03);
+   MB4Simulator secondSimulator(SECOND_SELECT_PIN);
+   secondSimulator.attachEncoder(0, &secondEncoder);
+   MB4Driver secondDriver(SECOND_SELECT_PIN, 0);
+   secondDriver.begin();
+   while (!secondDriver.poll() && !secondDriver.hasFailed()) {}
+
+   // A driver that hasn't been started can't join the bus
+   MB4Bus bus;
+   MB4Driver unstartedDriver(UNSTARTED_SELECT_PIN, 0);
+   bool busJoined = !bus.addDevice(&unstartedDriver) && bus.addDevice(&driver) && 
+                    bus.addDevice(&secondDriver);
+   bool synchronized = bus.beginSynchronized();
+   uint16_t maxSkew = 0;
+   int32_t maxError = 0;
+   for(uint16_t index = 0; index < SYNC_CAPTURES && synchronized; index++){
+      SyncCapture capture;
+      synchronized = bus.captureSynchronized(capture) && capture.numFrames == 2;
+      for(uint8_t frame = 0; frame < capture.numFrames && synchronized; frame++){
+         EncoderModel& model = (frame == 0) ? encoder : secondEncoder;
+         int32_t error = (int32_t)(capture.frames[frame].rawPosition 
+                                   - model.getPosition(capture.timestamp * 1000ULL));
+         error = error < 0 ? -error : error;
+         maxError = error > maxError ? error : maxError;
+         synchronized = capture.frames[frame].svalid == 2;
+      }
+      maxSkew = capture.skew > maxSkew ? capture.skew : maxSkew;
+   }
+   bus.endSynchronized();
+   synchronized &= maxError <= SYNC_TOLERANCE;
+   printf("synchronized: %s, %d captures, skew up to %u us, up to %ld counts from "
+          "the true position\n", synchronized ? "passed" : "FAILED", SYNC_CAPTURES,
+          maxSkew, (long)maxError);
+
+   // Scheduled reads of both MB4s, at a period the bus has time for, which 
+   // should read each new frame once
+   driver.setCyclePeriod(POLLED_PERIOD);
+   secondDriver.setCyclePeriod(POLLED_PERIOD);
+   bus.resetStatistics();
+   uint32_t busCycles[2] = {simulator.getCycles(), secondSimulator.getCycles()};
+   start = millis();
+   while (millis() - start < ACQUISITION_TIME) {
+      bus.service();
+   }
+   busCycles[0] = simulator.getCycles() - busCycles[0];
+   busCycles[1] = secondSimulator.getCycles() - busCycles[1];
+   bool busPassed = busJoined;
+   for(uint8_t device = 0; device < 2; device++){
+      busPassed &= bus.getSamples(device) <= busCycles[device] && 
+                   bus.getSamples(device) + busCycles[device] / BUS_MISSED_FRACTION >= busCycles[device];
+   }
+   printf("bus: %s, %lu and %lu new frames of %lu and %lu cycles, %lu and %lu skipped\n",
+          busPassed ? "passed" : "FAILED", (unsigned long)bus.getSamples(0), 
+          (unsigned long)bus.getSamples(1), (unsigned long)busCycles[0], 
+          (unsigned long)busCycles[1], (unsigned long)bus.getSkipped(0), 
+          (unsigned long)bus.getSkipped(1));
+
+   // Burst capture at a short cycle period without missing a cycle, with an 
+   // encoder register read finishing during it, then a dump of it to decode 
+   // again
+   static uint32_t burstTimestamps[BURST_SAMPLES];
+   static uint32_t burstPositions[BURST_SAMPLES];
+   static uint8_t burstStatus[BURST_SAMPLES];
+   BurstBuffer burst = {burstTimestamps, burstPositions, burstStatus, BURST_SAMPLES, 0};
+   driver.setSPIClock(BURST_SPI_CLOCK);
+   driver.setCyclePeriod(BURST_PERIOD);
+   delay(1);
+   bool burstTransfer = driver.requestEncoderRead(BISS_DEVICE_ID, BISS_DEVICE_ID_SIZE);
+   uint32_t burstSamples = driver.getTelemetry().samples;
+   firstCycle = simulator.getCycles();
+   start = micros();
+   uint16_t burstCount = driver.captureBurst(burst, BURST_SAMPLES);
+   uint32_t burstTime = micros() - start;
+   uint32_t burstCycles = simulator.getCycles() - firstCycle;
+   burstSamples = driver.getTelemetry().samples - burstSamples;
+
+   uint8_t deviceId[BISS_DEVICE_ID_SIZE];
+   burstTransfer &= driver.pollEncoderTransfer() == MB4Driver::transfer_done &&
+                    driver.readEncoderData(deviceId, BISS_DEVICE_ID_SIZE);
+   for(uint8_t index = 0; index < BISS_DEVICE_ID_SIZE && burstTransfer; index++){
+      burstTransfer = deviceId[index] == encoder.readBissRegister(BISS_DEVICE_ID + index);
+   }
+   int32_t burstError = 0;
+   uint32_t longestGap = 0;
+   driver.setSPIClock(SPI_CLOCK);
+   bool burstPassed = burstCount == BURST_SAMPLES && burstCycles <= burstCount + 1u &&
+                      burstSamples == burstCount && burstTransfer;
+   for(uint16_t sample = 0; sample < burstCount; sample++){
+      int32_t error = (int32_t)(burst.positions[sample] 
+                                - encoder.getPosition(burst.timestamps[sample] * 1000ULL));
+      error = error < 0 ? -error : error;
+      burstError = error > burstError ? error : burstError;
+      burstPassed &= burst.status[sample] == 0;
+      if (sample > 0) {
+         uint32_t gap = burst.timestamps[sample] - burst.timestamps[sample - 1];
+         longestGap = gap > longestGap ? gap : longestGap;
+      }
+   }
+   MemoryPrint dump;
+   driver.dumpBurst(burst, dump);
+   burstPassed &= burstError <= BURST_TOLERANCE && checkBurstDump(dump, burst);
+   printf("burst: %s, %u samples of %lu cycles in %lu us, gaps up to %lu us, up to %ld "
+          "counts from the true position, %u byte dump, register read %s\n", 
+          burstPassed ? "passed" : "FAILED", burstCount, (unsigned long)burstCycles, 
+          (unsigned long)burstTime, (unsigned long)longestGap, (long)burstError, 
+          (unsigned)dump.size, burstTransfer ? "done" : "FAILED");
+
+#ifdef MB4_TRACE
+   // Trace a few polled positions on their own
+   MB4Trace::clear();
+   for(uint8_t call = 0; call < TRACED_CALLS; call++){
+      driver.getPosition();
+   }
+   MB4Trace::print();
+#endif
+
+   return (mismatches == 0 && invalid >= INJECTED_CRC_ERRORS && softwarePassed &&
+           pollGuarded && registersPassed && registerStep == 5 && ratesPassed && synchronized && 
+           busPassed && burstPassed) ? 0 : 1;
+}
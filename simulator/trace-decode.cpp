@@ -0,0 +1,203 @@
+/* trace-decode.cpp
+   Turns the dumps of MB4Trace::print() into a readable timeline, on the host.
+   
+   California Polytechnic State University, San Luis Obispo
+   In partial fulfillment of the requirements for a bachelor's 
+   degree from the department of Mechanical Engineering. 
+
+   Michael George
+   10/21/16
+
+   This code comes without any warranty or guarantee from the author. 
+   Any usage is at the discretion of the user, and should be done 
+   at their own risk. 
+
+   This software is hereby licensed under the Modified BSD License.
+
+   Copyright (c) 2016, Michael George
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+       * Neither the name of the Accumulator Volume Sensing Team nor the
+         names of its contributors may be used to endorse or promote products
+         derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL ACCUMULATOR VOLUME SENSING TEAM BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "mb4-driver.h"
+
+// Longest line read from the dump
+#define LINE_LENGTH   256
+
+// opcodeName: gets the name of an SPI opcode of the MB4
+// Parameters: 
+// opcode: the opcode
+// returns: its name
+static const char* opcodeName(unsigned opcode){
+   switch (opcode) {
+      case WRITE_DATA:           return "WRITE_DATA";
+      case READ_DATA:            return "READ_DATA";
+      case READ_STATUS:          return "READ_STATUS";
+      case WRITE_INSTRUCTION:    return "WRITE_INSTRUCTION";
+      case READ_DATA0:           return "READ_DATA0";
+      case WRITE_DATA0:          return "WRITE_DATA0";
+      default:                   return "UNKNOWN";
+   }
+}
+
+// registerName: writes the name of a register of the MB4
+// Parameters: 
+// address: the address of the register
+// name: the buffer to write the name into
+// size: the size of the buffer
+// returns: nothing
+static void registerName(unsigned address, char* name, size_t size){
+   static const struct { unsigned address; const char* name; } names[] = {
+      {SLAVEID, "SLAVEID"}, {REGADR, "REGADR"}, {REGNUM, "REGNUM"},
+      {CHSEL, "CHSEL"}, {REGVERS, "REGVERS"}, {FREQ, "FREQ"}, 
+      {FREQAGS, "FREQAGS"}, {REVISION, "REVISION"}, {VERSION, "VERSION"},
+      {CFGCH2, "CFGCH2"}, {CFGCH1, "CFGCH1"}, {ACTnSENS, "ACTnSENS"}, 
+      {STATUS_REG, "STATUS_REG"}, {SVALID, "SVALID"}, {CDMTIMEOUT, "CDMTIMEOUT"},
+      {INSTR, "INSTR"}, {CFGIF, "CFGIF"}, {CDS_STATUS0, "CDS_STATUS0"}, 
+      {CDS_STATUS1, "CDS_STATUS1"}
+   };
+
+   for(size_t index = 0; index < sizeof(names) / sizeof(names[0]); index++){
+      if (names[index].address == address) {
+         snprintf(name, size, "%s", names[index].name);
+         return;
+      }
+   }
+
+   if (address < SCDATA1 + MAX_SLAVES * SCDATA_SIZE) {
+      snprintf(name, size, "SCDATA%u+%u", address / SCDATA_SIZE + 1, address % SCDATA_SIZE);
+   }
+   else if (address >= RDATA && address < RDATA + REGISTER_DATA_SIZE) {
+      snprintf(name, size, "RDATA+%u", address - RDATA);
+   }
+   else if (address >= SHADOW_START && address < SHADOW_START + MAX_SLAVES * SLAVE_CONFIG_SIZE) {
+      snprintf(name, size, "SLAVE%u_CONFIG+%u", (address - SHADOW_START) / SLAVE_CONFIG_SIZE + 1,
+               (address - SHADOW_START) % SLAVE_CONFIG_SIZE);
+   }
+   else {
+      snprintf(name, size, "0x%02X", address);
+   }
+}
+
+// instructionName: writes the bits of an instruction by name
+// Parameters: 
+// instruction: the instruction
+// name: the buffer to write the names into
+// size: the size of the buffer
+// returns: nothing
+static void instructionName(unsigned instruction, char* name, size_t size){
+   static const struct { unsigned bit; const char* name; } bits[] = {
+      {BREAK, "BREAK"}, {HOLDBANK, "HOLDBANK"}, {INIT, "INIT"}, {AGS, "AGS"}
+   };
+
+   name[0] = 0;
+   for(size_t index = 0; index < sizeof(bits) / sizeof(bits[0]); index++){
+      if (instruction & bits[index].bit) {
+         if (name[0] != 0) {
+            strncat(name, "|", size - strlen(name) - 1);
+         }
+         strncat(name, bits[index].name, size - strlen(name) - 1);
+      }
+   }
+   if (name[0] == 0) {
+      snprintf(name, size, "0");
+   }
+}
+
+// Reads a dump from standard input and writes the timeline to standard 
+// output. Lines that are not part of a dump are skipped, so a whole serial 
+// log can be given.
+int main(){
+   char line[LINE_LENGTH];
+   unsigned long transactions = 0;
+   unsigned long bytes = 0;
+   unsigned long busyMicros = 0;
+   unsigned long firstStart = 0;
+   unsigned long lastEnd = 0;
+
+   while (fgets(line, sizeof(line), stdin) != 0) {
+      unsigned long start, duration, pin, bytesSent, kept, overwritten;
+      unsigned long calls, callTransactions, callBytes, callMicros;
+      unsigned opcode, argument;
+
+      if (sscanf(line, "TRACE,%lu,%lu", &kept, &overwritten) == 2) {
+         printf("%lu transactions kept, %lu older ones overwritten\n\n", kept, overwritten);
+         printf("%12s %8s %8s %4s  %-18s %-18s %5s\n", 
+                "start(us)", "gap(us)", "dur(us)", "pin", "opcode", "argument", "bytes");
+         transactions = 0;
+         bytes = 0;
+         busyMicros = 0;
+      }
+      else if (sscanf(line, "E,%lu,%lu,%lu,%x,%x,%lu", &start, &duration, &pin, 
+                      &opcode, &argument, &bytesSent) == 6) {
+         char name[40];
+         if (opcode == WRITE_INSTRUCTION) {
+            instructionName(argument, name, sizeof(name));
+         }
+         else if (opcode == READ_STATUS) {
+            snprintf(name, sizeof(name), "-");
+         }
+         else {
+            registerName(argument, name, sizeof(name));
+         }
+
+         char gap[16];
+         if (transactions == 0) {
+            snprintf(gap, sizeof(gap), "-");
+            firstStart = start;
+         }
+         else {
+            snprintf(gap, sizeof(gap), "%lu", start - lastEnd);
+         }
+
+         printf("%12lu %8s %8lu %4lu  %-18s %-18s %5lu\n", 
+                start, gap, duration, pin, opcodeName(opcode), name, bytesSent);
+
+         transactions++;
+         bytes += bytesSent;
+         busyMicros += duration;
+         lastEnd = start + duration;
+      }
+      else if (sscanf(line, "CALLS,%lu,%lu,%lu,%lu", &calls, &callTransactions, 
+                      &callBytes, &callMicros) == 4) {
+         printf("\n%lu transactions, %lu bytes", transactions, bytes);
+         if (lastEnd > firstStart) {
+            printf(", bus busy %.1f%% of %lu us", 
+                   100.0 * busyMicros / (lastEnd - firstStart), lastEnd - firstStart);
+         }
+         printf("\n");
+
+         if (calls > 0) {
+            printf("%lu position calls: %.2f transactions, %.2f bytes and %.1f us per call\n",
+                   calls, (double)callTransactions / calls, (double)callBytes / calls, 
+                   (double)callMicros / calls);
+         }
+         printf("\n");
+      }
+   }
+
+   return 0;
+}